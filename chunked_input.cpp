@@ -0,0 +1,264 @@
+#include "chunked_input.h"
+
+#include <cstdlib> // exit
+#include <cstring> // memchr
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const char* findNextNewline(const char* position, const char* end) {
+#ifdef __SSE2__
+  const __m128i newlines = _mm_set1_epi8('\n');
+  for (; position + 16 <= end; position += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+    int newlineMask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines));
+    if (newlineMask != 0) {
+      return position + __builtin_ctz(newlineMask);
+    }
+  }
+#endif
+  while (position < end && *position != '\n') {
+    ++position;
+  }
+  return position;
+}
+
+void splitFields(const char* start, const char* end, int numberOfFields, const char* fieldStarts[],
+    const char* fieldEnds[]) {
+  const char* position = start;
+  for (int fieldIndex = 0; fieldIndex < numberOfFields; ++fieldIndex) {
+    fieldStarts[fieldIndex] = position;
+    const char* tab = static_cast<const char*>(memchr(position, '\t', end - position));
+    fieldEnds[fieldIndex] = (tab != NULL) ? tab : end;
+    position = (tab != NULL) ? tab + 1 : end;
+  }
+}
+
+// the largest amount of data in one BGZF block
+const int MAXIMUM_BGZF_BLOCK_SIZE = 65536;
+
+/** The size of the BGZF block at 'offset' (its BSIZE + 1), or 0 if no BGZF block starts there **/
+size_t getBgzfBlockSize(const unsigned char* data, size_t fileSize, size_t offset) {
+  const unsigned char* block = data + offset;
+  if (fileSize - offset < 18 || block[0] != 0x1f || block[1] != 0x8b || block[2] != 8 || !(block[3] & 4)) {
+    return 0;
+  }
+  size_t extraLength = block[10] | (block[11] << 8);
+  for (size_t subfield = 12; subfield + 4 <= 12 + extraLength && subfield + 6 <= fileSize - offset;) {
+    size_t subfieldLength = block[subfield + 2] | (block[subfield + 3] << 8);
+    if (block[subfield] == 'B' && block[subfield + 1] == 'C' && subfieldLength == 2) {
+      size_t blockSize = (block[subfield + 4] | (block[subfield + 5] << 8)) + 1;
+      return (blockSize <= fileSize - offset) ? blockSize : 0;
+    }
+    subfield += 4 + subfieldLength;
+  }
+  return 0;
+}
+
+ChunkedInput::ChunkedInput(const std::string& fileName) : data_(NULL), fileSize_(0), compression_(NONE) {
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  struct stat fileStatus;
+  if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0) {
+    std::cerr << "ChunkedInput error: cannot open " << fileName << std::endl;
+    exit(-1);
+  }
+  fileSize_ = fileStatus.st_size;
+  if (fileSize_ > 0) {
+    void* mapping = mmap(NULL, fileSize_, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+      std::cerr << "ChunkedInput error: cannot map " << fileName << " into memory." << std::endl;
+      exit(-1);
+    }
+    data_ = static_cast<const unsigned char*>(mapping);
+    madvise(mapping, fileSize_, MADV_SEQUENTIAL);
+  }
+  close(fileDescriptor);
+
+  if (fileSize_ < 2 || data_[0] != 0x1f || data_[1] != 0x8b) {
+    return;
+  }
+  compression_ = BGZF;
+  for (size_t offset = 0; offset < fileSize_;) {
+    size_t blockSize = getBgzfBlockSize(data_, fileSize_, offset);
+    if (blockSize == 0) {
+      compression_ = GZIP;
+      blockOffsets_.clear();
+      return;
+    }
+    blockOffsets_.push_back(offset);
+    offset += blockSize;
+  }
+  blockOffsets_.push_back(fileSize_);
+}
+
+ChunkedInput::~ChunkedInput() {
+  if (data_ != NULL) {
+    munmap(const_cast<unsigned char*>(data_), fileSize_);
+  }
+}
+
+/**
+ * Splits the data of one part into lines, also when the data arrives in pieces (one per
+ * decompressed block): a line that continues in the next piece is collected in 'carry_'.
+ */
+class PartReader {
+public:
+  PartReader(LineHandler& handler, bool startsAtLineStart) : handler_(handler), hasLineEnding_(startsAtLineStart) {
+  }
+
+  void read(const char* start, const char* end) {
+    const char* position = start;
+    const char* newline;
+    while ((newline = findNextNewline(position, end)) != end) {
+      if (!hasLineEnding_) {
+        firstFragment_.swap(carry_);
+        firstFragment_.append(position, newline);
+        hasLineEnding_ = true;
+      } else if (carry_.empty()) {
+        handler_.handleLine(position, newline);
+      } else {
+        carry_.append(position, newline);
+        handler_.handleLine(carry_.data(), carry_.data() + carry_.length());
+      }
+      carry_.clear();
+      position = newline + 1;
+    }
+    carry_.append(position, end);
+  }
+
+  void finish(std::string& firstFragment, std::string& lastFragment, bool& hasLineEnding) {
+    hasLineEnding = hasLineEnding_;
+    if (hasLineEnding_) {
+      firstFragment.swap(firstFragment_);
+      lastFragment.swap(carry_);
+    } else {
+      firstFragment.swap(carry_);
+      lastFragment.clear();
+    }
+  }
+
+private:
+  LineHandler& handler_;
+  bool hasLineEnding_;
+  std::string firstFragment_;
+  std::string carry_;
+};
+
+void ChunkedInput::readPart(int partIndex, int numberOfParts, LineHandler& handler, std::string& firstFragment,
+    std::string& lastFragment, bool& hasLineEnding) const {
+  PartReader reader(handler, partIndex == 0);
+  if (compression_ == NONE) {
+    const char* text = reinterpret_cast<const char*>(data_);
+    reader.read(text + fileSize_ * partIndex / numberOfParts, text + fileSize_ * (partIndex + 1) / numberOfParts);
+    reader.finish(firstFragment, lastFragment, hasLineEnding);
+    return;
+  }
+
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+  std::vector<char> buffer(MAXIMUM_BGZF_BLOCK_SIZE);
+  if (compression_ == BGZF) {
+    // raw deflate data, as each block has its own gzip header and trailer
+    inflateInit2(&stream, -15);
+    int numberOfBlocks = blockOffsets_.size() - 1;
+    int firstBlock = static_cast<long long>(numberOfBlocks) * partIndex / numberOfParts;
+    int endBlock = static_cast<long long>(numberOfBlocks) * (partIndex + 1) / numberOfParts;
+    for (int blockIndex = firstBlock; blockIndex < endBlock; ++blockIndex) {
+      const unsigned char* block = data_ + blockOffsets_[blockIndex];
+      size_t blockSize = blockOffsets_[blockIndex + 1] - blockOffsets_[blockIndex];
+      size_t headerSize = 12 + (block[10] | (block[11] << 8));
+      inflateReset(&stream);
+      stream.next_in = const_cast<unsigned char*>(block + headerSize);
+      stream.avail_in = blockSize - headerSize - 8;
+      stream.next_out = reinterpret_cast<unsigned char*>(&buffer[0]);
+      stream.avail_out = buffer.size();
+      if (inflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        std::cerr << "ChunkedInput error: corrupt BGZF block at byte " << blockOffsets_[blockIndex] << std::endl;
+        exit(-1);
+      }
+      reader.read(&buffer[0], &buffer[0] + (buffer.size() - stream.avail_out));
+    }
+  } else if (partIndex == 0) {
+    // a gzip file can only be decompressed from its start, so the first part reads all of it
+    inflateInit2(&stream, 15 + 16);
+    stream.next_in = const_cast<unsigned char*>(data_);
+    stream.avail_in = fileSize_;
+    int status = Z_OK;
+    do {
+      stream.next_out = reinterpret_cast<unsigned char*>(&buffer[0]);
+      stream.avail_out = buffer.size();
+      status = inflate(&stream, Z_NO_FLUSH);
+      if (status != Z_OK && status != Z_STREAM_END) {
+        std::cerr << "ChunkedInput error: corrupt gzip data." << std::endl;
+        exit(-1);
+      }
+      reader.read(&buffer[0], &buffer[0] + (buffer.size() - stream.avail_out));
+      if (status == Z_STREAM_END && stream.avail_in > 0) {
+        inflateReset(&stream); // a gzip file may consist of several concatenated members
+        status = Z_OK;
+      }
+    } while (status != Z_STREAM_END && (stream.avail_in > 0 || stream.avail_out == 0));
+  } else {
+    reader.finish(firstFragment, lastFragment, hasLineEnding);
+    return;
+  }
+  inflateEnd(&stream);
+  reader.finish(firstFragment, lastFragment, hasLineEnding);
+}
+
+/** What one thread leaves of its part: the fragments of the lines that continue in other parts **/
+struct PartResult {
+  std::string firstFragment_;
+  std::string lastFragment_;
+  bool hasLineEnding_;
+};
+
+void readPartOfInput(const ChunkedInput* input, int partIndex, int numberOfParts, LineHandler* handler,
+    PartResult* result) {
+  input->readPart(partIndex, numberOfParts, *handler, result->firstFragment_, result->lastFragment_,
+    result->hasLineEnding_);
+}
+
+void readLinesInParallel(const ChunkedInput& input, const std::vector<LineHandler*>& handlers) {
+  int numberOfParts = handlers.size();
+  std::vector<PartResult> results(numberOfParts);
+  if (numberOfParts == 1) {
+    readPartOfInput(&input, 0, 1, handlers[0], &results[0]);
+  } else {
+    std::vector<std::thread> workers;
+    for (int partIndex = 0; partIndex < numberOfParts; ++partIndex) {
+      workers.push_back(std::thread(readPartOfInput, &input, partIndex, numberOfParts, handlers[partIndex],
+        &results[partIndex]));
+    }
+    for (int partIndex = 0; partIndex < numberOfParts; ++partIndex) {
+      workers[partIndex].join();
+    }
+  }
+
+  // join the fragments at the borders of the parts into lines
+  std::string line = results[0].lastFragment_;
+  int partOfLine = 0;
+  for (int partIndex = 1; partIndex < numberOfParts; ++partIndex) {
+    line += results[partIndex].firstFragment_;
+    if (results[partIndex].hasLineEnding_) {
+      if (!line.empty()) {
+        handlers[partOfLine]->handleLine(line.data(), line.data() + line.length());
+      }
+      line = results[partIndex].lastFragment_;
+      partOfLine = partIndex;
+    }
+  }
+  if (!line.empty()) {
+    handlers[partOfLine]->handleLine(line.data(), line.data() + line.length());
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef CHUNKED_INPUT_H
+#define CHUNKED_INPUT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * 'LineHandler' receives the lines of a file read by readLinesInParallel, one
+ * call per line, without the line ending. Each thread has its own handler, so
+ * handlers need no locking; their results are combined afterwards.
+ */
+class LineHandler {
+public:
+  virtual ~LineHandler() {}
+  virtual void handleLine(const char* start, const char* end) = 0;
+};
+
+/**
+ * 'ChunkedInput' gives access to a text file in parts that can be read by
+ * different threads. Plain files are mapped into memory and divided at
+ * arbitrary bytes; BGZF files (bgzip, as used for indexed VCF files) are
+ * divided at block boundaries, and each thread decompresses its own blocks.
+ * Other gzip files cannot be divided, so they are read as a single part.
+ */
+class ChunkedInput {
+public:
+  ChunkedInput(const std::string& fileName);
+  ~ChunkedInput();
+
+  // reads part 'partIndex' of 'numberOfParts'. Lines that lie completely within the part go to the
+  // handler; the bytes before the first line ending of the part and after the last one are returned
+  // as fragments, to be joined with those of the neighbouring parts. If the part has no line ending
+  // at all, 'hasLineEnding' is false and the whole part is in firstFragment. The first part starts
+  // at the start of a line, so its firstFragment is always empty
+  void readPart(int partIndex, int numberOfParts, LineHandler& handler, std::string& firstFragment,
+    std::string& lastFragment, bool& hasLineEnding) const;
+
+private:
+  ChunkedInput(const ChunkedInput&);
+  ChunkedInput& operator=(const ChunkedInput&);
+
+  enum Compression { NONE, BGZF, GZIP };
+
+  const unsigned char* data_;
+  size_t fileSize_;
+  Compression compression_;
+  std::vector<size_t> blockOffsets_; // of the BGZF blocks, plus the end of the file
+};
+
+// reads all lines of the input with as many threads as there are handlers (at least one); lines
+// that span the parts of two threads go to the handler of the thread in whose part they start
+void readLinesInParallel(const ChunkedInput& input, const std::vector<LineHandler*>& handlers);
+
+// finds the first '\n' at or after 'position', or returns 'end'. With SSE2, 16 bytes are compared at once
+const char* findNextNewline(const char* position, const char* end);
+
+// splits the start of a line into its first 'numberOfFields' tab-separated fields, without copying them.
+// The last field runs up to the next tab; fields beyond the end of the line are empty and lie at 'end'
+void splitFields(const char* start, const char* end, int numberOfFields, const char* fieldStarts[],
+  const char* fieldEnds[]);
+
+#endif // CHUNKED_INPUT_H
@@ -0,0 +1,86 @@
+#include "edit_distance.h"
+
+#include <vector>
+
+typedef unsigned long long Word;
+
+const int WORD_SIZE = 64;
+const int NUMBER_OF_BASE_CODES = 5; // A, C, G, T, and anything else
+
+int baseCode(char base) {
+  switch (base) {
+    case 'A': case 'a': return 0;
+    case 'C': case 'c': return 1;
+    case 'G': case 'g': return 2;
+    case 'T': case 't': return 3;
+    default: return 4;
+  }
+}
+
+/**
+ * Follows Hyyro's multi-word version of Myers' algorithm: the columns of the
+ * matrix are stored as bit vectors of vertical +1 (positive) and -1 (negative)
+ * differences between consecutive rows, and a whole column is computed from
+ * the previous one with a handful of word operations per 64 rows. The score in
+ * the last row is tracked, which yields the global edit distance at the end.
+ */
+int editDistance(const std::string& firstSequence, const std::string& secondSequence, int maxDistance) {
+  // the shorter sequence is the 'pattern' along the rows, so it needs fewer words
+  const std::string& pattern = (firstSequence.length() <= secondSequence.length()) ? firstSequence : secondSequence;
+  const std::string& text = (firstSequence.length() <= secondSequence.length()) ? secondSequence : firstSequence;
+  int patternLength = pattern.length();
+  int textLength = text.length();
+  if (maxDistance >= 0 && textLength - patternLength > maxDistance) {
+    return maxDistance + 1;
+  }
+  if (patternLength == 0) {
+    return textLength;
+  }
+
+  int numberOfBlocks = (patternLength + WORD_SIZE - 1) / WORD_SIZE;
+  std::vector<Word> matchMasks(NUMBER_OF_BASE_CODES * numberOfBlocks, 0); // per base: the rows where it occurs
+  for (int row = 0; row < patternLength; ++row) {
+    matchMasks[baseCode(pattern[row]) * numberOfBlocks + row / WORD_SIZE] |= Word(1) << (row % WORD_SIZE);
+  }
+  std::vector<Word> positiveVertical(numberOfBlocks, ~Word(0)); // the first column: row i has distance i
+  std::vector<Word> negativeVertical(numberOfBlocks, 0);
+  int lastRowBit = (patternLength - 1) % WORD_SIZE;
+  const Word HIGH_BIT = Word(1) << (WORD_SIZE - 1);
+
+  int score = patternLength;
+  for (int column = 0; column < textLength; ++column) {
+    const Word* columnMatches = &matchMasks[baseCode(text[column]) * numberOfBlocks];
+    int horizontalIn = 1; // global alignment: the top row increases by one per column
+    for (int block = 0; block < numberOfBlocks; ++block) {
+      Word matches = columnMatches[block];
+      Word positive = positiveVertical[block];
+      Word negative = negativeVertical[block];
+      Word xVertical = matches | negative;
+      if (horizontalIn < 0) {
+        matches |= 1;
+      }
+      Word xHorizontal = (((matches & positive) + positive) ^ positive) | matches;
+      Word positiveHorizontal = negative | ~(xHorizontal | positive);
+      Word negativeHorizontal = positive & xHorizontal;
+      if (block == numberOfBlocks - 1) {
+        score += ((positiveHorizontal >> lastRowBit) & 1) ? 1 : (((negativeHorizontal >> lastRowBit) & 1) ? -1 : 0);
+      }
+      int horizontalOut = (positiveHorizontal & HIGH_BIT) ? 1 : ((negativeHorizontal & HIGH_BIT) ? -1 : 0);
+      positiveHorizontal <<= 1;
+      negativeHorizontal <<= 1;
+      if (horizontalIn < 0) {
+        negativeHorizontal |= 1;
+      } else if (horizontalIn > 0) {
+        positiveHorizontal |= 1;
+      }
+      positiveVertical[block] = negativeHorizontal | ~(xVertical | positiveHorizontal);
+      negativeVertical[block] = positiveHorizontal & xVertical;
+      horizontalIn = horizontalOut;
+    }
+    // each remaining column can lower the score by at most one
+    if (maxDistance >= 0 && score - (textLength - column - 1) > maxDistance) {
+      return maxDistance + 1;
+    }
+  }
+  return score;
+}
@@ -0,0 +1,12 @@
+#ifndef EDIT_DISTANCE_H
+#define EDIT_DISTANCE_H
+
+#include <string>
+
+// the edit (Levenshtein) distance between two DNA sequences, computed with Myers' bit-parallel
+// algorithm (64 rows of the alignment matrix per machine word). Bases are compared case-insensitively;
+// all non-ACGT characters count as the same 'base'. If the distance exceeds maxDistance (when that is
+// not negative), the computation stops early and maxDistance + 1 is returned
+int editDistance(const std::string& firstSequence, const std::string& secondSequence, int maxDistance = -1);
+
+#endif // EDIT_DISTANCE_H
@@ -0,0 +1,45 @@
+#include "event_type.h"
+
+#include "symbolic_alleles.h"
+
+EventClass classifyEvent(const std::string& referenceAllele, const std::string& alternativeAllele) {
+  if (isSymbolicAllele(alternativeAllele)) {
+    std::string symbolicType = getSymbolicAlleleType(alternativeAllele);
+    if (symbolicType == "INS") {
+      return INSERTION_CLASS;
+    } else if (symbolicType == "DEL") {
+      return DELETION_CLASS;
+    }
+    return REPLACEMENT_CLASS;
+  }
+  bool haveSameFirstBase = !referenceAllele.empty() && !alternativeAllele.empty() &&
+    referenceAllele[0] == alternativeAllele[0];
+  if (referenceAllele.length() == 1) {
+    if (alternativeAllele.length() == 1) {
+      return SNP_CLASS;
+    } else if (alternativeAllele.length() > 1 && haveSameFirstBase) {
+      return INSERTION_CLASS;
+    }
+  } else if (referenceAllele.length() > 1 && alternativeAllele.length() == 1 && haveSameFirstBase) {
+    return DELETION_CLASS;
+  }
+  return REPLACEMENT_CLASS;
+}
+
+const char* getEventClassName(EventClass eventClass) {
+  static const char* const names[NUMBER_OF_EVENT_CLASSES] = { "INS", "DEL", "SNP", "RPL" };
+  return names[eventClass];
+}
+
+EventCounts::EventCounts() : numberOfRecords_(0) {
+  for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+    numberPerClass_[eventClass] = 0;
+  }
+}
+
+void EventCounts::add(const EventCounts& otherCounts) {
+  numberOfRecords_ += otherCounts.numberOfRecords_;
+  for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+    numberPerClass_[eventClass] += otherCounts.numberPerClass_[eventClass];
+  }
+}
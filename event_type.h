@@ -0,0 +1,28 @@
+#ifndef EVENT_TYPE_H
+#define EVENT_TYPE_H
+
+#include <string>
+
+enum EventClass { INSERTION_CLASS, DELETION_CLASS, SNP_CLASS, REPLACEMENT_CLASS };
+
+const int NUMBER_OF_EVENT_CLASSES = 4;
+
+// classifies an event by its REF and ALT like compare does: an SNP has single-base alleles, an insertion
+// ("A AT") and a deletion ("AT A") keep the first base; everything else is a replacement. Symbolic
+// alleles are classified by their type (<INS:ME> is an insertion, <DUP> a replacement)
+EventClass classifyEvent(const std::string& referenceAllele, const std::string& alternativeAllele);
+
+// "INS", "DEL", "SNP" or "RPL"
+const char* getEventClassName(EventClass eventClass);
+
+/** The number of records of a chromosome (or of a whole file), and of its events per EventClass **/
+struct EventCounts {
+  EventCounts();
+
+  void add(const EventCounts& otherCounts);
+
+  long long numberOfRecords_;
+  long long numberPerClass_[NUMBER_OF_EVENT_CLASSES];
+};
+
+#endif // EVENT_TYPE_H
@@ -0,0 +1,398 @@
+#include "genotypes.h"
+
+#include <cstring> // memchr
+
+#ifdef CHECK_PACKED_GENOTYPES
+#include <algorithm> // find
+#include <cctype> // isdigit
+#include <cstdlib> // atoi, exit
+#include <iostream>
+#include <map>
+#endif
+
+int countBits(unsigned long long word) {
+  return __builtin_popcountll(word);
+}
+
+PackedGenotypes::PackedGenotypes() : numberOfSamples_(0), numberOfWords_(0), numberOfSlots_(0) {
+}
+
+void PackedGenotypes::parse(const char* firstSample, const char* end) {
+  numberOfSamples_ = 0;
+  numberOfWords_ = 0;
+  numberOfSlots_ = 0;
+  largeAlleles_.clear();
+  const char* position = firstSample;
+  while (position < end) {
+    int sampleIndex = numberOfSamples_++;
+    if (sampleIndex % SAMPLES_PER_WORD == 0) {
+      ++numberOfWords_;
+      for (int slot = 0; slot < numberOfSlots_; ++slot) {
+        AllelePlanes& planes = slots_[slot];
+        planes.present_.push_back(0);
+        planes.called_.push_back(0);
+        planes.lowBit_.push_back(0);
+        planes.highBit_.push_back(0);
+        planes.phased_.push_back(0);
+        planes.isLarge_.push_back(0);
+      }
+    }
+    bool isPhased = false;
+    for (int slot = 0; position < end; ++slot) {
+      int allele = -1;
+      if (*position == '.') {
+        ++position;
+      } else if (*position >= '0' && *position <= '9') {
+        allele = 0;
+        for (; position < end && *position >= '0' && *position <= '9'; ++position) {
+          allele = allele * 10 + (*position - '0');
+        }
+      } else {
+        break; // an empty GT, or the end of the GT
+      }
+      setCall(sampleIndex, slot, allele, isPhased);
+      if (position == end || (*position != '/' && *position != '|')) {
+        break;
+      }
+      isPhased = (*position == '|');
+      ++position;
+    }
+    position = static_cast<const char*>(memchr(position, '\t', end - position));
+    if (position == NULL) {
+      break;
+    }
+    ++position;
+  }
+  indexLargeAlleles();
+#ifdef CHECK_PACKED_GENOTYPES
+  checkAgainstScalarDecoding(firstSample, end);
+#endif
+}
+
+/** Counts the large calls per word, so getAllele can find a call's entry in largeAlleles_ without a search **/
+void PackedGenotypes::indexLargeAlleles() {
+  largeAllelesBeforeWord_.clear();
+  if (largeAlleles_.empty()) {
+    return;
+  }
+  int numberOfLargeAlleles = 0;
+  for (int wordIndex = 0; wordIndex < numberOfWords_; ++wordIndex) {
+    largeAllelesBeforeWord_.push_back(numberOfLargeAlleles);
+    for (int slot = 0; slot < numberOfSlots_; ++slot) {
+      numberOfLargeAlleles += countBits(slots_[slot].isLarge_[wordIndex]);
+    }
+  }
+}
+
+/** Adds the planes for one more allele slot, or reuses those left by an earlier record **/
+void PackedGenotypes::addSlot() {
+  if (numberOfSlots_ == slots_.size()) {
+    slots_.push_back(AllelePlanes());
+  }
+  AllelePlanes& planes = slots_[numberOfSlots_];
+  planes.present_.assign(numberOfWords_, 0);
+  planes.called_.assign(numberOfWords_, 0);
+  planes.lowBit_.assign(numberOfWords_, 0);
+  planes.highBit_.assign(numberOfWords_, 0);
+  planes.phased_.assign(numberOfWords_, 0);
+  planes.isLarge_.assign(numberOfWords_, 0);
+  ++numberOfSlots_;
+}
+
+void PackedGenotypes::setCall(int sampleIndex, int slot, int allele, bool isPhased) {
+  while (slot >= numberOfSlots_) {
+    addSlot();
+  }
+  AllelePlanes& planes = slots_[slot];
+  int wordIndex = sampleIndex / SAMPLES_PER_WORD;
+  Word bit = 1ULL << (sampleIndex % SAMPLES_PER_WORD);
+  planes.present_[wordIndex] |= bit;
+  if (isPhased) {
+    planes.phased_[wordIndex] |= bit;
+  }
+  if (allele < 0) {
+    return;
+  }
+  planes.called_[wordIndex] |= bit;
+  int code = allele;
+  if (allele > 3) {
+    code = 3;
+    planes.isLarge_[wordIndex] |= bit;
+    LargeAllele largeAllele = { sampleIndex, slot, allele };
+    largeAlleles_.push_back(largeAllele);
+  }
+  if (code & 1) {
+    planes.lowBit_[wordIndex] |= bit;
+  }
+  if (code & 2) {
+    planes.highBit_[wordIndex] |= bit;
+  }
+}
+
+int PackedGenotypes::numberOfSamples() const {
+  return numberOfSamples_;
+}
+
+int PackedGenotypes::ploidy() const {
+  return numberOfSlots_;
+}
+
+int PackedGenotypes::countCalls(int sampleIndex) const {
+  int wordIndex = sampleIndex / SAMPLES_PER_WORD;
+  Word bit = 1ULL << (sampleIndex % SAMPLES_PER_WORD);
+  int slot = 0;
+  while (slot < numberOfSlots_ && (slots_[slot].present_[wordIndex] & bit)) {
+    ++slot;
+  }
+  return slot;
+}
+
+int PackedGenotypes::getAllele(int sampleIndex, int slot) const {
+  if (slot >= numberOfSlots_) {
+    return -1;
+  }
+  const AllelePlanes& planes = slots_[slot];
+  int wordIndex = sampleIndex / SAMPLES_PER_WORD;
+  Word bit = 1ULL << (sampleIndex % SAMPLES_PER_WORD);
+  if (!(planes.called_[wordIndex] & bit)) {
+    return -1;
+  }
+  if (planes.isLarge_[wordIndex] & bit) {
+    // largeAlleles_ is in the order of sample and slot, so the entry's index is the number of large calls
+    // of earlier samples, plus those of this sample in earlier slots
+    Word earlierSamples = bit - 1;
+    int largeAlleleIndex = largeAllelesBeforeWord_[wordIndex];
+    for (int otherSlot = 0; otherSlot < numberOfSlots_; ++otherSlot) {
+      Word isLarge = slots_[otherSlot].isLarge_[wordIndex];
+      largeAlleleIndex += countBits(isLarge & earlierSamples) + ((otherSlot < slot && (isLarge & bit)) ? 1 : 0);
+    }
+    return largeAlleles_[largeAlleleIndex].allele_;
+  }
+  return ((planes.highBit_[wordIndex] & bit) ? 2 : 0) + ((planes.lowBit_[wordIndex] & bit) ? 1 : 0);
+}
+
+bool PackedGenotypes::isPhased(int sampleIndex, int slot) const {
+  if (slot >= numberOfSlots_) {
+    return false;
+  }
+  return (slots_[slot].phased_[sampleIndex / SAMPLES_PER_WORD] >> (sampleIndex % SAMPLES_PER_WORD)) & 1;
+}
+
+void PackedGenotypes::appendGenotype(int sampleIndex, std::string& output, const std::vector<int>* alleleMap) const {
+  int wordIndex = sampleIndex / SAMPLES_PER_WORD;
+  Word bit = 1ULL << (sampleIndex % SAMPLES_PER_WORD);
+  int nextLargeAllele = -1; // the entry in largeAlleles_ of the next large call of this sample, once needed
+  for (int slot = 0; slot < numberOfSlots_ && (slots_[slot].present_[wordIndex] & bit); ++slot) {
+    const AllelePlanes& planes = slots_[slot];
+    if (slot > 0) {
+      output += (planes.phased_[wordIndex] & bit) ? '|' : '/';
+    }
+    int allele = -1;
+    if (!(planes.called_[wordIndex] & bit)) {
+      // not called, written as '.'
+    } else if (planes.isLarge_[wordIndex] & bit) {
+      // the large calls of a sample are consecutive in largeAlleles_, so only the first one is looked up
+      if (nextLargeAllele < 0) {
+        nextLargeAllele = largeAllelesBeforeWord_[wordIndex];
+        for (int otherSlot = 0; otherSlot < numberOfSlots_; ++otherSlot) {
+          nextLargeAllele += countBits(slots_[otherSlot].isLarge_[wordIndex] & (bit - 1));
+        }
+      }
+      allele = largeAlleles_[nextLargeAllele++].allele_;
+    } else {
+      allele = ((planes.highBit_[wordIndex] & bit) ? 2 : 0) + ((planes.lowBit_[wordIndex] & bit) ? 1 : 0);
+    }
+    if (allele >= 0 && alleleMap != NULL) {
+      allele = (allele < alleleMap->size()) ? (*alleleMap)[allele] : 0;
+    }
+    if (allele < 0) {
+      output += '.';
+    } else if (allele < 10) {
+      output += static_cast<char>('0' + allele);
+    } else {
+      std::string digits;
+      for (; allele > 0; allele /= 10) {
+        digits.insert(digits.begin(), static_cast<char>('0' + allele % 10));
+      }
+      output += digits;
+    }
+  }
+}
+
+int PackedGenotypes::numberOfSampleGroups() const {
+  return numberOfWords_;
+}
+
+void PackedGenotypes::classifySampleGroup(int groupIndex, Word& homozygousReference, Word& heterozygous,
+    Word& homozygousAlternative, Word& missing) const {
+  int numberOfSamplesInGroup = numberOfSamples_ - groupIndex * SAMPLES_PER_WORD;
+  Word samples = (numberOfSamplesInGroup >= SAMPLES_PER_WORD) ? ~0ULL : (1ULL << numberOfSamplesInGroup) - 1;
+  if (numberOfSlots_ == 0) {
+    homozygousReference = heterozygous = homozygousAlternative = 0;
+    missing = samples;
+    return;
+  }
+  // a sample is complete if it has a first call and all its calls are called; the calls of a sample fill
+  // the first slots, so a slot without a call of the sample does not make it incomplete
+  const AllelePlanes& first = slots_[0];
+  Word complete = first.called_[groupIndex];
+  Word mixed = 0;
+  Word hasLargeAllele = first.isLarge_[groupIndex];
+  for (int slot = 1; slot < numberOfSlots_; ++slot) {
+    const AllelePlanes& planes = slots_[slot];
+    complete &= ~planes.present_[groupIndex] | planes.called_[groupIndex];
+    mixed |= planes.called_[groupIndex] & ((first.lowBit_[groupIndex] ^ planes.lowBit_[groupIndex]) |
+      (first.highBit_[groupIndex] ^ planes.highBit_[groupIndex]) |
+      (first.isLarge_[groupIndex] ^ planes.isLarge_[groupIndex]));
+    hasLargeAllele |= planes.isLarge_[groupIndex];
+  }
+  // calls that are all above 3 look the same in the planes, so compare their exact values
+  Word uncertain = complete & ~mixed & hasLargeAllele;
+  while (uncertain != 0) {
+    int bitIndex = __builtin_ctzll(uncertain);
+    uncertain &= uncertain - 1;
+    int sampleIndex = groupIndex * SAMPLES_PER_WORD + bitIndex;
+    int firstAllele = getAllele(sampleIndex, 0);
+    for (int slot = 1; slot < numberOfSlots_ && ((slots_[slot].present_[groupIndex] >> bitIndex) & 1); ++slot) {
+      if (getAllele(sampleIndex, slot) != firstAllele) {
+        mixed |= 1ULL << bitIndex;
+        break;
+      }
+    }
+  }
+  Word isAlternative = first.lowBit_[groupIndex] | first.highBit_[groupIndex];
+  missing = samples & ~complete;
+  heterozygous = complete & mixed;
+  homozygousAlternative = complete & ~mixed & isAlternative;
+  homozygousReference = complete & ~mixed & ~isAlternative;
+}
+
+int PackedGenotypes::countCalledAlleles() const {
+  int count = 0;
+  for (int slot = 0; slot < numberOfSlots_; ++slot) {
+    for (int wordIndex = 0; wordIndex < numberOfWords_; ++wordIndex) {
+      count += countBits(slots_[slot].called_[wordIndex]);
+    }
+  }
+  return count;
+}
+
+int PackedGenotypes::countAllele(int allele) const {
+  int count = 0;
+  if (allele > 3) {
+    for (int i = 0; i < largeAlleles_.size(); ++i) {
+      count += (largeAlleles_[i].allele_ == allele);
+    }
+    return count;
+  }
+  for (int slot = 0; slot < numberOfSlots_; ++slot) {
+    const AllelePlanes& planes = slots_[slot];
+    for (int wordIndex = 0; wordIndex < numberOfWords_; ++wordIndex) {
+      Word lowBit = planes.lowBit_[wordIndex];
+      Word highBit = planes.highBit_[wordIndex];
+      Word matches = planes.called_[wordIndex] & ~planes.isLarge_[wordIndex] &
+        ((allele & 1) ? lowBit : ~lowBit) & ((allele & 2) ? highBit : ~highBit);
+      count += countBits(matches);
+    }
+  }
+  return count;
+}
+
+int PackedGenotypes::countHeterozygous() const {
+  int count = 0;
+  for (int groupIndex = 0; groupIndex < numberOfWords_; ++groupIndex) {
+    Word homozygousReference, heterozygous, homozygousAlternative, missing;
+    classifySampleGroup(groupIndex, homozygousReference, heterozygous, homozygousAlternative, missing);
+    count += countBits(heterozygous);
+  }
+  return count;
+}
+
+int PackedGenotypes::countHomozygousAlternative() const {
+  int count = 0;
+  for (int groupIndex = 0; groupIndex < numberOfWords_; ++groupIndex) {
+    Word homozygousReference, heterozygous, homozygousAlternative, missing;
+    classifySampleGroup(groupIndex, homozygousReference, heterozygous, homozygousAlternative, missing);
+    count += countBits(homozygousAlternative);
+  }
+  return count;
+}
+
+std::set<int> PackedGenotypes::getUsedAlternativeAlleles() const {
+  std::set<int> usedAlleles;
+  for (int allele = 1; allele <= 3; ++allele) {
+    if (countAllele(allele) > 0) {
+      usedAlleles.insert(allele);
+    }
+  }
+  for (int i = 0; i < largeAlleles_.size(); ++i) {
+    usedAlleles.insert(largeAlleles_[i].allele_);
+  }
+  return usedAlleles;
+}
+
+#ifdef CHECK_PACKED_GENOTYPES
+/**
+ * Decodes the GTs again, one call at a time and without the planes, and exits if AN, the AC of any
+ * allele, the number of het or hom-alt samples or any single call differs from what the planes give.
+ */
+void PackedGenotypes::checkAgainstScalarDecoding(const char* firstSample, const char* end) const {
+  std::map<int, int> alleleCounts;
+  int numberOfCalledAlleles = 0;
+  int numberOfHeterozygous = 0;
+  int numberOfHomozygousAlternative = 0;
+  bool callsMatch = true;
+  int sampleIndex = 0;
+  for (const char* position = firstSample; position < end; ++sampleIndex) {
+    const char* sampleEnd = static_cast<const char*>(memchr(position, '\t', end - position));
+    if (sampleEnd == NULL) {
+      sampleEnd = end;
+    }
+    const char* gtEnd = std::find(position, sampleEnd, ':');
+    std::vector<int> alleles;
+    for (const char* callStart = position; callStart < gtEnd;) {
+      const char* callEnd = callStart;
+      if (*callStart == '.') {
+        alleles.push_back(-1);
+        ++callEnd;
+      } else if (isdigit(*callStart)) {
+        alleles.push_back(atoi(callStart));
+        while (callEnd < gtEnd && isdigit(*callEnd)) {
+          ++callEnd;
+        }
+      } else {
+        break; // an empty GT, or text after the calls
+      }
+      if (callEnd == gtEnd || (*callEnd != '/' && *callEnd != '|')) {
+        break;
+      }
+      callStart = callEnd + 1;
+    }
+    bool isComplete = !alleles.empty();
+    bool isMixed = false;
+    for (int slot = 0; slot < alleles.size(); ++slot) {
+      if (alleles[slot] < 0) {
+        isComplete = false;
+      } else {
+        ++numberOfCalledAlleles;
+        ++alleleCounts[alleles[slot]];
+        isMixed = isMixed || (alleles[slot] != alleles[0]);
+      }
+      callsMatch = callsMatch && (getAllele(sampleIndex, slot) == alleles[slot]);
+    }
+    numberOfHeterozygous += (isComplete && isMixed);
+    numberOfHomozygousAlternative += (isComplete && !isMixed && alleles[0] > 0);
+    position = sampleEnd + 1;
+  }
+  bool countsMatch = numberOfCalledAlleles == countCalledAlleles() && numberOfHeterozygous == countHeterozygous() &&
+    numberOfHomozygousAlternative == countHomozygousAlternative();
+  for (std::map<int, int>::const_iterator countIt = alleleCounts.begin(); countIt != alleleCounts.end(); ++countIt) {
+    countsMatch = countsMatch && (countAllele(countIt->first) == countIt->second);
+  }
+  if (!callsMatch || !countsMatch || sampleIndex != numberOfSamples_) {
+    std::cerr << "PackedGenotypes error: the bit planes differ from the GTs " << std::string(firstSample, end) <<
+      std::endl;
+    exit(-1);
+  }
+}
+#endif
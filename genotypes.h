@@ -0,0 +1,91 @@
+#ifndef GENOTYPES_H
+#define GENOTYPES_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * 'PackedGenotypes' holds the GT calls of all samples of one VCF record in
+ * bit planes: for every allele slot (the first and second allele of a diploid
+ * call, ...) one bit per sample says whether the call is present, whether it
+ * is called (not '.'), and the two bits of its allele index, so 64 samples are
+ * handled per machine word and counts are popcounts. Allele indices above 3 are
+ * stored as 3, with their exact value kept aside, so records with many ALT
+ * alleles are still decoded exactly; the exact value of a call is found in
+ * constant time by counting the large calls before it in the planes.
+ * Compiled with -DCHECK_PACKED_GENOTYPES, parse compares the counts of every
+ * record with those of a plain decoder of the GT text, and exits on a difference.
+ */
+class PackedGenotypes {
+public:
+  typedef unsigned long long Word;
+
+  // the number of samples whose calls share one word of a bit plane
+  static const int SAMPLES_PER_WORD = 64;
+
+  PackedGenotypes();
+
+  // decodes the GT (the first subfield) of every sample column; 'firstSample' points to the
+  // start of the first sample column, 'end' to the end of the line
+  void parse(const char* firstSample, const char* end);
+
+  int numberOfSamples() const;
+  int ploidy() const; // the largest number of alleles of any sample
+  int countCalls(int sampleIndex) const; // the number of alleles of one sample, including missing ones
+
+  // the allele index of a call; -1 if it is missing ('.') or absent (a haploid sample has no second call)
+  int getAllele(int sampleIndex, int slot) const;
+  // whether the separator before the call in 'slot' (1 or higher) is '|'
+  bool isPhased(int sampleIndex, int slot) const;
+  // writes the GT of a sample, like "0|1" or "./."; with an allele map, allele i is written as
+  // alleleMap[i] (alleles beyond the end of the map as 0), so ALT alleles can be renumbered
+  void appendGenotype(int sampleIndex, std::string& output, const std::vector<int>* alleleMap = NULL) const;
+
+  int countCalledAlleles() const; // AN
+  int countAllele(int allele) const; // AC of one allele (for 0, AN minus the AC of all ALT alleles)
+  int countHeterozygous() const; // samples with calls that are not all the same allele (and none '.')
+  int countHomozygousAlternative() const; // samples whose calls are all the same ALT allele
+  std::set<int> getUsedAlternativeAlleles() const;
+
+  // the samples in groups of SAMPLES_PER_WORD, one per word of the planes: group g starts at sample
+  // g * SAMPLES_PER_WORD
+  int numberOfSampleGroups() const;
+  // classifies the samples of one group at once, setting each sample's bit in exactly one mask: 'missing'
+  // if it has no calls or a '.' among them, else 'heterozygous' if its calls differ, 'homozygousAlternative'
+  // if they are all the same ALT allele and 'homozygousReference' if they are all 0
+  void classifySampleGroup(int groupIndex, Word& homozygousReference, Word& heterozygous,
+    Word& homozygousAlternative, Word& missing) const;
+
+private:
+  struct AllelePlanes {
+    std::vector<Word> present_;
+    std::vector<Word> called_;
+    std::vector<Word> lowBit_;
+    std::vector<Word> highBit_;
+    std::vector<Word> phased_; // the separator before this call was '|'
+    std::vector<Word> isLarge_; // allele index > 3; the exact value is in largeAlleles_
+  };
+
+  struct LargeAllele {
+    int sampleIndex_;
+    int slot_;
+    int allele_;
+  };
+
+  void addSlot();
+  void setCall(int sampleIndex, int slot, int allele, bool isPhased);
+  void indexLargeAlleles();
+#ifdef CHECK_PACKED_GENOTYPES
+  void checkAgainstScalarDecoding(const char* firstSample, const char* end) const;
+#endif
+
+  int numberOfSamples_;
+  int numberOfWords_;
+  int numberOfSlots_;
+  std::vector<AllelePlanes> slots_; // may hold more than numberOfSlots_, to reuse their memory
+  std::vector<LargeAllele> largeAlleles_; // in the order of sample and slot
+  std::vector<int> largeAllelesBeforeWord_; // per word: the number of large calls of the samples of earlier words
+};
+
+#endif // GENOTYPES_H
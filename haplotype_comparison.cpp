@@ -0,0 +1,266 @@
+#include "haplotype_comparison.h"
+
+#include <algorithm> // max, stable_sort
+#include <cctype> // toupper
+#include <cstdlib> // atoi
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "reference.h"
+
+/** A record that can be applied to the reference: a single ALT allele of bases, REF as in the reference. **/
+struct ReplayEvent {
+  int position_;
+  int end_; // the position after the last reference base
+  std::string referenceAllele_;
+  std::string alternativeAllele_;
+  int recordIndex_; // in the first file; -1 for events of the second file
+};
+
+/** The replayable events of one chromosome, of both files, each in the order of the files. **/
+struct ChromosomeEvents {
+  std::vector<ReplayEvent> comparedEvents_;
+  std::vector<ReplayEvent> comparisonEvents_;
+};
+
+/** The events of both files that lie close together, and the part of the reference they cover. **/
+struct Cluster {
+  std::vector<const ReplayEvent*> comparedEvents_;
+  std::vector<const ReplayEvent*> comparisonEvents_;
+  int start_;
+  int end_;
+};
+
+std::string toUpperCase(const std::string& sequence) {
+  std::string result = sequence;
+  for (int i = 0; i < result.length(); ++i) {
+    result[i] = toupper(result[i]);
+  }
+  return result;
+}
+
+bool isBaseSequence(const std::string& allele) {
+  if (allele.empty()) {
+    return false;
+  }
+  for (int i = 0; i < allele.length(); ++i) {
+    char base = allele[i];
+    if (base != 'A' && base != 'C' && base != 'G' && base != 'T' && base != 'N') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Reads the records of a VCF file into per-chromosome lists; returns the number of records. **/
+int readEvents(const std::string& nameOfFile, bool isComparedFile, std::map<std::string, ChromosomeEvents>& events,
+    std::vector<std::string>& chromosomeOrder) {
+  std::ifstream inputFile(nameOfFile.c_str());
+  if (!inputFile.is_open()) {
+    std::cerr << "replayClusters error: cannot open " << nameOfFile << std::endl;
+    exit(-1);
+  }
+  int numberOfRecords = 0;
+  std::string line;
+  while (getline(inputFile, line)) {
+    if (line.length() == 0 || line[0] == '#') {
+      continue;
+    }
+    size_t fieldStarts[5];
+    fieldStarts[0] = 0;
+    bool isComplete = true;
+    for (int fieldIndex = 1; fieldIndex < 5 && isComplete; ++fieldIndex) {
+      size_t tabPosition = line.find('\t', fieldStarts[fieldIndex - 1]);
+      isComplete = (tabPosition != std::string::npos);
+      fieldStarts[fieldIndex] = tabPosition + 1;
+    }
+    int recordIndex = numberOfRecords++;
+    if (!isComplete) {
+      continue;
+    }
+    size_t altEnd = line.find('\t', fieldStarts[4]);
+    ReplayEvent event;
+    event.position_ = atoi(line.c_str() + fieldStarts[1]);
+    event.referenceAllele_ = toUpperCase(line.substr(fieldStarts[3], fieldStarts[4] - 1 - fieldStarts[3]));
+    event.alternativeAllele_ = toUpperCase(line.substr(fieldStarts[4],
+      (altEnd == std::string::npos) ? std::string::npos : altEnd - fieldStarts[4]));
+    event.end_ = event.position_ + event.referenceAllele_.length();
+    event.recordIndex_ = isComparedFile ? recordIndex : -1;
+    if (!isBaseSequence(event.referenceAllele_) || !isBaseSequence(event.alternativeAllele_) ||
+        event.referenceAllele_ == event.alternativeAllele_ || event.position_ < 1) {
+      continue;
+    }
+    std::string chromosomeName = line.substr(0, fieldStarts[1] - 1);
+    if (events.find(chromosomeName) == events.end()) {
+      if (!isComparedFile) {
+        continue; // events on chromosomes without events in the first file cannot match anything
+      }
+      chromosomeOrder.push_back(chromosomeName);
+    }
+    ChromosomeEvents& chromosomeEvents = events[chromosomeName];
+    (isComparedFile ? chromosomeEvents.comparedEvents_ : chromosomeEvents.comparisonEvents_).push_back(event);
+  }
+  return numberOfRecords;
+}
+
+bool hasReferenceAllele(const ReferenceSequence& chromosome, const ReplayEvent& event) {
+  return toUpperCase(chromosome.substr(event.position_, event.referenceAllele_.length())) == event.referenceAllele_;
+}
+
+bool startsBefore(const ReplayEvent* leftEvent, const ReplayEvent* rightEvent) {
+  return leftEvent->position_ < rightEvent->position_;
+}
+
+/**
+ * Merges the events of both files (those whose REF agrees with the reference) into
+ * clusters: an event joins the current cluster if it starts less than clusterDistance
+ * after the end of the cluster.
+ */
+std::vector<Cluster> makeClusters(const ReferenceSequence& chromosome, const ChromosomeEvents& events,
+    int clusterDistance) {
+  std::vector<const ReplayEvent*> sortedEvents;
+  for (int i = 0; i < events.comparedEvents_.size(); ++i) {
+    if (hasReferenceAllele(chromosome, events.comparedEvents_[i])) {
+      sortedEvents.push_back(&events.comparedEvents_[i]);
+    }
+  }
+  for (int i = 0; i < events.comparisonEvents_.size(); ++i) {
+    if (hasReferenceAllele(chromosome, events.comparisonEvents_[i])) {
+      sortedEvents.push_back(&events.comparisonEvents_[i]);
+    }
+  }
+  std::stable_sort(sortedEvents.begin(), sortedEvents.end(), startsBefore);
+
+  std::vector<Cluster> clusters;
+  for (int i = 0; i < sortedEvents.size(); ++i) {
+    const ReplayEvent* event = sortedEvents[i];
+    if (clusters.empty() || event->position_ >= clusters.back().end_ + clusterDistance) {
+      clusters.push_back(Cluster());
+      clusters.back().start_ = event->position_;
+      clusters.back().end_ = event->end_;
+    }
+    Cluster& cluster = clusters.back();
+    cluster.end_ = std::max(cluster.end_, event->end_);
+    (event->recordIndex_ >= 0 ? cluster.comparedEvents_ : cluster.comparisonEvents_).push_back(event);
+  }
+  return clusters;
+}
+
+// selects all events of a cluster, however many there are
+const unsigned int ALL_EVENTS = ~0u;
+
+/**
+ * Applies the events selected by the bits of 'selection' to the reference between the
+ * start and end of the cluster. Returns false if selected events overlap, as they
+ * cannot then be on the same haplotype.
+ */
+bool applyEvents(const std::string& referenceWindow, int windowStart, const std::vector<const ReplayEvent*>& events,
+    unsigned int selection, std::string& haplotype) {
+  haplotype.clear();
+  int copiedUntil = windowStart;
+  for (int i = 0; i < events.size(); ++i) {
+    if (selection != ALL_EVENTS && !(selection & (1u << i))) {
+      continue;
+    }
+    const ReplayEvent& event = *events[i];
+    if (event.position_ < copiedUntil) {
+      return false;
+    }
+    haplotype.append(referenceWindow, copiedUntil - windowStart, event.position_ - copiedUntil);
+    haplotype += event.alternativeAllele_;
+    copiedUntil = event.end_;
+  }
+  haplotype.append(referenceWindow, copiedUntil - windowStart, std::string::npos);
+  return true;
+}
+
+/**
+ * Records which of the first file's events match: those that are part of a combination of
+ * events that yields the same haplotype as some combination of the second file's events.
+ * Overlapping events (like two deletions at one site) need different combinations.
+ * Clusters with too many events are only compared as a whole; if that fails, their events
+ * are left NOT_REPLAYABLE, so they are compared the usual way.
+ */
+void replayCluster(const ReferenceSequence& chromosome, const Cluster& cluster, std::vector<ReplayResult>& results) {
+  const std::vector<const ReplayEvent*>& comparedEvents = cluster.comparedEvents_;
+  const std::vector<const ReplayEvent*>& comparisonEvents = cluster.comparisonEvents_;
+  if (comparedEvents.empty()) {
+    return;
+  }
+  unsigned int matchedEvents = 0;
+  if (!comparisonEvents.empty()) {
+    std::string referenceWindow = toUpperCase(chromosome.substr(cluster.start_, cluster.end_ - cluster.start_));
+    std::string haplotype;
+    if (comparedEvents.size() > MAXIMUM_REPLAYED_EVENTS || comparisonEvents.size() > MAXIMUM_REPLAYED_EVENTS) {
+      std::string otherHaplotype;
+      bool isValid = applyEvents(referenceWindow, cluster.start_, comparedEvents, ALL_EVENTS, haplotype) &&
+        applyEvents(referenceWindow, cluster.start_, comparisonEvents, ALL_EVENTS, otherHaplotype);
+      ReplayResult result = (isValid && haplotype == otherHaplotype) ? REPLAY_MATCH : NOT_REPLAYABLE;
+      for (int i = 0; i < comparedEvents.size(); ++i) {
+        results[comparedEvents[i]->recordIndex_] = result;
+      }
+      return;
+    }
+
+    std::set<std::string> comparisonHaplotypes;
+    for (unsigned int selection = 1; selection < (1u << comparisonEvents.size()); ++selection) {
+      if (applyEvents(referenceWindow, cluster.start_, comparisonEvents, selection, haplotype)) {
+        comparisonHaplotypes.insert(haplotype);
+      }
+    }
+    for (unsigned int selection = 1; selection < (1u << comparedEvents.size()); ++selection) {
+      if ((selection & ~matchedEvents) != 0 &&
+          applyEvents(referenceWindow, cluster.start_, comparedEvents, selection, haplotype) &&
+          comparisonHaplotypes.count(haplotype) > 0) {
+        matchedEvents |= selection;
+      }
+    }
+  }
+  for (int i = 0; i < comparedEvents.size(); ++i) {
+    results[comparedEvents[i]->recordIndex_] = (matchedEvents & (1u << i)) ? REPLAY_MATCH : REPLAY_MISMATCH;
+  }
+}
+
+/** Replays every numberOfThreads-th cluster, starting at firstIndex. **/
+void replayClusterRange(const ReferenceSequence* chromosome, const std::vector<Cluster>* clusters,
+    std::vector<ReplayResult>* results, int firstIndex, int numberOfThreads) {
+  for (int clusterIndex = firstIndex; clusterIndex < clusters->size(); clusterIndex += numberOfThreads) {
+    replayCluster(*chromosome, (*clusters)[clusterIndex], *results);
+  }
+}
+
+std::vector<ReplayResult> replayClusters(const std::string& nameOfComparedFile,
+    const std::string& nameOfComparisonFile, const std::string& nameOfReference, int clusterDistance,
+    int numberOfThreads) {
+  std::map<std::string, ChromosomeEvents> events;
+  std::vector<std::string> chromosomeOrder;
+  int numberOfRecords = readEvents(nameOfComparedFile, true, events, chromosomeOrder);
+  readEvents(nameOfComparisonFile, false, events, chromosomeOrder);
+  std::vector<ReplayResult> results(numberOfRecords, NOT_REPLAYABLE);
+
+  ReferenceGenome referenceGenome(nameOfReference);
+  for (int i = 0; i < chromosomeOrder.size(); ++i) {
+    referenceGenome.addExpectedChromosome(chromosomeOrder[i]);
+  }
+  for (int i = 0; i < chromosomeOrder.size(); ++i) {
+    const ReferenceSequence& chromosome = referenceGenome.getChromosome(chromosomeOrder[i]);
+    std::vector<Cluster> clusters = makeClusters(chromosome, events[chromosomeOrder[i]], clusterDistance);
+    if (numberOfThreads == 1) {
+      replayClusterRange(&chromosome, &clusters, &results, 0, 1);
+    } else {
+      std::vector<std::thread> workers;
+      for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+        workers.push_back(std::thread(replayClusterRange, &chromosome, &clusters, &results, threadIndex,
+          numberOfThreads));
+      }
+      for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+        workers[threadIndex].join();
+      }
+    }
+    events.erase(chromosomeOrder[i]);
+  }
+  return results;
+}
@@ -0,0 +1,21 @@
+#ifndef HAPLOTYPE_COMPARISON_H
+#define HAPLOTYPE_COMPARISON_H
+
+#include <string>
+#include <vector>
+
+enum ReplayResult { NOT_REPLAYABLE, REPLAY_MISMATCH, REPLAY_MATCH };
+
+// the largest number of events per file in a cluster for which every combination of events is tried
+const int MAXIMUM_REPLAYED_EVENTS = 10;
+
+// compares the records of two VCF files by their effect on the reference: nearby events of both files
+// (less than clusterDistance apart) form a cluster, and a record of the first file matches if it belongs to
+// a combination of its cluster's events that spells the same sequence as a combination of the second file's
+// events in that cluster. Returns a result for each record of the first file; records that cannot be replayed
+// (symbolic or multiple ALT alleles, REF not in the reference) are NOT_REPLAYABLE
+std::vector<ReplayResult> replayClusters(const std::string& nameOfComparedFile,
+  const std::string& nameOfComparisonFile, const std::string& nameOfReference, int clusterDistance,
+  int numberOfThreads);
+
+#endif // HAPLOTYPE_COMPARISON_H
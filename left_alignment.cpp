@@ -0,0 +1,167 @@
+#include "left_alignment.h"
+
+#include <algorithm> // reverse
+#include <cctype> // toupper
+
+/**
+ * Returns the allele after it has been shifted from 'position' to 'newPosition': the bases of the
+ * chromosome that the shift passed, followed by the start of the original allele, cut to the
+ * original length.
+ */
+std::string shiftAllele(const ReferenceSequence& chromosome, int position, int newPosition,
+    const std::string& allele) {
+  int shift = position - newPosition;
+  if (shift >= allele.length()) {
+    return chromosome.substr(newPosition, allele.length());
+  }
+  return chromosome.substr(newPosition, shift) + allele.substr(0, allele.length() - shift);
+}
+
+/**
+ * Left-aligning an indel repeatedly moves it one base to the left as long as the base that leaves the
+ * allele at the right equals the base that enters it at the left. Rebuilding the alleles at every step
+ * makes a shift through a long repeat quadratic, so the total shift is determined first, by comparing
+ * the bases the alleles would have without building them, and the alleles are built once at the end.
+ */
+AlignmentResult leftAlignIndel(const ReferenceSequence& chromosome, int& position,
+    std::string& referenceAllele, std::string& alternativeAllele) {
+  bool isInsertion = (referenceAllele.length() == 1 && alternativeAllele.length() > 1 &&
+    alternativeAllele.find(",") == std::string::npos);
+  bool isDeletion = (referenceAllele.length() > 1 && alternativeAllele.length() == 1);
+  if (!isInsertion && !isDeletion) {
+    return NOT_AN_INDEL;
+  }
+  if (referenceAllele[0] != chromosome[position]) {
+    return REFERENCE_MISMATCH;
+  }
+
+  int newPosition = position;
+  if (isInsertion) {
+    // after a shift of k bases, the last base of the alternative allele is the base at index
+    // (length - k) of the original allele or, once k exceeds the length, the chromosome's base there
+    int alleleLength = alternativeAllele.length();
+    while (newPosition > 1) {
+      int indexOfLastBase = alleleLength - 1 - (position - newPosition);
+      char lastBase = (indexOfLastBase >= 0) ? alternativeAllele[indexOfLastBase] :
+        chromosome[position + indexOfLastBase];
+      if (lastBase != chromosome[newPosition]) {
+        break;
+      }
+      --newPosition;
+    }
+    if (newPosition == position) {
+      return ALIGNED;
+    }
+    alternativeAllele = shiftAllele(chromosome, position, newPosition, alternativeAllele);
+    referenceAllele = std::string(1, chromosome[newPosition]);
+  } else {
+    int eventLength = referenceAllele.length() - alternativeAllele.length();
+    while (newPosition > 1 && chromosome[newPosition + eventLength] == chromosome[newPosition]) {
+      --newPosition;
+    }
+    if (newPosition == position) {
+      return ALIGNED;
+    }
+    referenceAllele = shiftAllele(chromosome, position, newPosition, referenceAllele);
+    alternativeAllele = std::string(1, chromosome[newPosition]);
+  }
+  position = newPosition;
+  return ALIGNED;
+}
+
+bool isNucleotideSequence(const std::string& allele) {
+  if (allele.empty()) {
+    return false;
+  }
+  for (int i = 0; i < allele.length(); ++i) {
+    char base = toupper(allele[i]);
+    if (base != 'A' && base != 'C' && base != 'G' && base != 'T' && base != 'N') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * The alleles are kept reversed, with the index of their current last base, so that both steps of
+ * the shift - dropping the last base and adding a base in front - take constant time, and shifting
+ * a multi-allelic record through a long repeat stays linear in the length of the shift.
+ */
+AlignmentResult normalizeAlleles(const ReferenceSequence& chromosome, int& position,
+    std::vector<std::string>& alleles) {
+  for (int i = 0; i < alleles.size(); ++i) {
+    if (!isNucleotideSequence(alleles[i])) {
+      return SYMBOLIC_ALLELE;
+    }
+  }
+  for (int i = 1; i < alleles.size(); ++i) {
+    if (alleles[i] == alleles[0]) {
+      return ALIGNED; // a 'variant' without variation cannot be shifted anywhere
+    }
+  }
+  if (toupper(alleles[0][0]) != toupper(chromosome[position])) {
+    return REFERENCE_MISMATCH;
+  }
+
+  int numberOfAlleles = alleles.size();
+  std::vector<std::string> reversedAlleles(alleles);
+  std::vector<int> indicesOfLastBases(numberOfAlleles, 0);
+  for (int i = 0; i < numberOfAlleles; ++i) {
+    std::reverse(reversedAlleles[i].begin(), reversedAlleles[i].end());
+  }
+
+  // trim identical last bases, extending all alleles to the left when one of them would become empty
+  bool isChanged = false;
+  while (true) {
+    char lastBase = toupper(reversedAlleles[0][indicesOfLastBases[0]]);
+    bool haveSameLastBase = true;
+    bool hasSingleBaseAllele = false;
+    for (int i = 0; i < numberOfAlleles; ++i) {
+      haveSameLastBase = haveSameLastBase && (toupper(reversedAlleles[i][indicesOfLastBases[i]]) == lastBase);
+      hasSingleBaseAllele = hasSingleBaseAllele || (reversedAlleles[i].length() - indicesOfLastBases[i] == 1);
+    }
+    if (!haveSameLastBase) {
+      break;
+    }
+    if (hasSingleBaseAllele) {
+      if (position <= 1) {
+        break;
+      }
+      --position;
+      char precedingBase = toupper(chromosome[position]);
+      for (int i = 0; i < numberOfAlleles; ++i) {
+        reversedAlleles[i] += precedingBase;
+      }
+    }
+    for (int i = 0; i < numberOfAlleles; ++i) {
+      ++indicesOfLastBases[i];
+    }
+    isChanged = true;
+  }
+
+  // trim identical first bases, as long as no allele becomes empty
+  while (true) {
+    char firstBase = toupper(reversedAlleles[0][reversedAlleles[0].length() - 1]);
+    bool canTrim = true;
+    for (int i = 0; i < numberOfAlleles && canTrim; ++i) {
+      int alleleLength = reversedAlleles[i].length() - indicesOfLastBases[i];
+      canTrim = (alleleLength > 1 && toupper(reversedAlleles[i][reversedAlleles[i].length() - 1]) == firstBase);
+    }
+    if (!canTrim) {
+      break;
+    }
+    for (int i = 0; i < numberOfAlleles; ++i) {
+      reversedAlleles[i].erase(reversedAlleles[i].length() - 1);
+    }
+    ++position;
+    isChanged = true;
+  }
+
+  if (isChanged) {
+    for (int i = 0; i < numberOfAlleles; ++i) {
+      alleles[i] = reversedAlleles[i].substr(indicesOfLastBases[i]);
+      std::reverse(alleles[i].begin(), alleles[i].end());
+    }
+  }
+  return ALIGNED;
+}
@@ -0,0 +1,23 @@
+#ifndef LEFT_ALIGNMENT_H
+#define LEFT_ALIGNMENT_H
+
+#include <string>
+#include <vector>
+
+#include "reference.h"
+
+enum AlignmentResult { ALIGNED, NOT_AN_INDEL, SYMBOLIC_ALLELE, REFERENCE_MISMATCH };
+
+// shifts a pure insertion ("A AT") or deletion ("AT A") to its leftmost position
+// on the chromosome, updating position and alleles; other events are left alone
+AlignmentResult leftAlignIndel(const ReferenceSequence& chromosome, int& position,
+  std::string& referenceAllele, std::string& alternativeAllele);
+
+// normalizes a record of any type (SNP, MNP, indel, complex, multi-allelic; alleles[0] is the
+// reference allele) like vt normalize: alleles that end in the same base are trimmed at the right
+// (extending them to the left when needed), then shared leading bases are trimmed, so the result is
+// the shortest, leftmost representation. Records with symbolic alleles (<DEL>, *, ...) are left alone
+AlignmentResult normalizeAlleles(const ReferenceSequence& chromosome, int& position,
+  std::vector<std::string>& alleles);
+
+#endif // LEFT_ALIGNMENT_H
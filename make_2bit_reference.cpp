@@ -0,0 +1,234 @@
+/**
+  make_2bit_reference.cpp
+
+  Purpose: converts a reference genome in FASTA format into the (UCSC) 2bit format: four bases
+  per byte plus tables of N-runs and of lowercase (soft-masked) runs. This only needs to be done
+  once per reference. left_align, del_corr, standardize and read_reference accept the 2bit file
+  in place of the FASTA file; they map it into memory instead of loading chromosomes, so all
+  processes that run at the same time share a single copy of the reference, which is also four
+  times smaller than the text version.
+
+  Usage: ./make_2bit reference_fasta reference_2bit
+  Example: ./make_2bit hg38.fa hg38.2bit
+
+  Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
+**/
+
+#include <cctype> // isspace, islower, toupper
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "reference.h"
+
+/** Utility function that halts/crashes the program, helps to catch bugs early.
+**/
+void Require(bool requirementMet, std::string errorMessage) {
+  if (!requirementMet) {
+    std::cerr << errorMessage << std::endl;
+    exit(-1);
+  }
+}
+
+/**
+ * 'SequenceLayout' holds what needs to be known about a sequence before its packed
+ * bases can be written: its name, its length, and where its N-runs and lowercase runs are.
+ */
+struct SequenceLayout {
+  std::string name_;
+  unsigned int length_;
+  std::vector<unsigned int> nBlockStarts_;
+  std::vector<unsigned int> nBlockSizes_;
+  std::vector<unsigned int> maskBlockStarts_;
+  std::vector<unsigned int> maskBlockSizes_;
+
+  /** the number of bytes the sequence record takes in the 2bit file **/
+  size_t recordSize() const {
+    return 4 * (4 + nBlockStarts_.size() * 2 + maskBlockStarts_.size() * 2) + (length_ + 3) / 4;
+  }
+};
+
+std::string getChromosomeName(const std::string& line) {
+  std::stringstream ss;
+  ss << line;
+  std::string chromosomeName;
+  ss >> chromosomeName;
+  chromosomeName = chromosomeName.substr(1); // skip '>'
+  return chromosomeName;
+}
+
+/** Like faToTwoBit, all characters except A, C, G and T are stored as N **/
+bool isUnknownBase(char base) {
+  char baseInUpperCase = toupper(base);
+  return !(baseInUpperCase == 'A' || baseInUpperCase == 'C' || baseInUpperCase == 'G' || baseInUpperCase == 'T');
+}
+
+/** Extends the current run (or starts a new one) if the base at 'offset' belongs in it. **/
+void addToBlocks(bool inBlock, unsigned int offset, std::vector<unsigned int>& blockStarts,
+    std::vector<unsigned int>& blockSizes) {
+  if (!inBlock) {
+    return;
+  }
+  if (!blockStarts.empty() && blockStarts.back() + blockSizes.back() == offset) {
+    ++blockSizes.back();
+  } else {
+    blockStarts.push_back(offset);
+    blockSizes.push_back(1);
+  }
+}
+
+/** First pass over the FASTA file: determines the layout of every sequence. **/
+std::vector<SequenceLayout> getLayouts(std::ifstream& fastaFile) {
+  std::vector<SequenceLayout> layouts;
+  std::string line;
+  while (getline(fastaFile, line)) {
+    if (line.length() == 0) {
+      continue;
+    }
+    if (line[0] == '>') {
+      layouts.push_back(SequenceLayout());
+      layouts.back().name_ = getChromosomeName(line);
+      layouts.back().length_ = 0;
+      Require(layouts.back().name_.length() < 256, "make_2bit error: the name " + layouts.back().name_ +
+        " is too long for the 2bit format.");
+      continue;
+    }
+    Require(!layouts.empty(), "make_2bit error: the FASTA file does not start with a '>' line.");
+    SequenceLayout& layout = layouts.back();
+    for (int i = 0; i < line.length(); ++i) {
+      if (isspace(line[i])) {
+        continue;
+      }
+      addToBlocks(isUnknownBase(line[i]), layout.length_, layout.nBlockStarts_, layout.nBlockSizes_);
+      addToBlocks(islower(line[i]), layout.length_, layout.maskBlockStarts_, layout.maskBlockSizes_);
+      ++layout.length_;
+    }
+  }
+  return layouts;
+}
+
+void writeWord(std::ofstream& outputFile, unsigned int word) {
+  outputFile.write(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+void writeWords(std::ofstream& outputFile, const std::vector<unsigned int>& words) {
+  if (!words.empty()) {
+    outputFile.write(reinterpret_cast<const char*>(&words[0]), words.size() * sizeof(unsigned int));
+  }
+}
+
+/** Packs four bases into a byte, first base in the most significant bits (T=0, C=1, A=2, G=3) **/
+unsigned char baseCode(char base) {
+  switch (toupper(base)) {
+    case 'C': return 1;
+    case 'A': return 2;
+    case 'G': return 3;
+    default: return 0; // T, and N, which is recorded in the N-blocks
+  }
+}
+
+void transformFile(const std::string& nameOfInputFile, const std::string& nameOfOutputFile) {
+  std::ifstream fastaFile(nameOfInputFile.c_str());
+  Require(fastaFile.is_open(), "make_2bit error: cannot open " + nameOfInputFile);
+  std::vector<SequenceLayout> layouts = getLayouts(fastaFile);
+
+  std::ofstream outputFile(nameOfOutputFile.c_str(), std::ios::binary);
+  writeWord(outputFile, TWO_BIT_SIGNATURE);
+  writeWord(outputFile, 0); // version
+  writeWord(outputFile, layouts.size());
+  writeWord(outputFile, 0); // reserved
+
+  size_t indexSize = 0;
+  for (int i = 0; i < layouts.size(); ++i) {
+    indexSize += 1 + layouts[i].name_.length() + 4;
+  }
+  size_t recordOffset = 16 + indexSize;
+  for (int i = 0; i < layouts.size(); ++i) {
+    unsigned char nameLength = layouts[i].name_.length();
+    outputFile.put(nameLength);
+    outputFile << layouts[i].name_;
+    Require(recordOffset <= 0xFFFFFFFFu, "make_2bit error: reference too large for a version 0 2bit file.");
+    writeWord(outputFile, recordOffset);
+    recordOffset += layouts[i].recordSize();
+  }
+
+  // second pass: write the records, packing the bases while rereading the FASTA file
+  fastaFile.clear();
+  fastaFile.seekg(0, fastaFile.beg);
+  std::string line;
+  int layoutIndex = -1;
+  unsigned char packedBases = 0;
+  unsigned int basesInSequence = 0;
+  while (true) {
+    bool hasLine = !getline(fastaFile, line).fail();
+    bool startsNewSequence = !hasLine || (line.length() > 0 && line[0] == '>');
+    if (startsNewSequence && layoutIndex >= 0 && basesInSequence % 4 != 0) {
+      // pad the last byte of the previous sequence
+      outputFile.put(packedBases << (2 * (4 - basesInSequence % 4)));
+    }
+    if (!hasLine) {
+      break;
+    }
+    if (startsNewSequence) {
+      ++layoutIndex;
+      const SequenceLayout& layout = layouts[layoutIndex];
+      writeWord(outputFile, layout.length_);
+      writeWord(outputFile, layout.nBlockStarts_.size());
+      writeWords(outputFile, layout.nBlockStarts_);
+      writeWords(outputFile, layout.nBlockSizes_);
+      writeWord(outputFile, layout.maskBlockStarts_.size());
+      writeWords(outputFile, layout.maskBlockStarts_);
+      writeWords(outputFile, layout.maskBlockSizes_);
+      writeWord(outputFile, 0); // reserved
+      basesInSequence = 0;
+      packedBases = 0;
+      std::cout << "Converting " << layout.name_ << " (" << layout.length_ << " bases)" << std::endl;
+      continue;
+    }
+    for (int i = 0; i < line.length(); ++i) {
+      if (isspace(line[i])) {
+        continue;
+      }
+      packedBases = (packedBases << 2) | baseCode(line[i]);
+      ++basesInSequence;
+      if (basesInSequence % 4 == 0) {
+        outputFile.put(packedBases);
+        packedBases = 0;
+      }
+    }
+  }
+  fastaFile.close();
+  outputFile.close();
+}
+
+int main(int argc, char** argv) {
+  if (argc == 1) {
+    std::cout <<
+      "make_2bit\n"
+      "\n"
+      "Purpose: converts a reference genome in FASTA format into the (UCSC) 2bit format: four bases "
+      "per byte plus tables of N-runs and of lowercase (soft-masked) runs. This only needs to be done "
+      "once per reference. left_align, del_corr, standardize and read_reference accept the 2bit file "
+      "in place of the FASTA file; they map it into memory instead of loading chromosomes, so all "
+      "processes that run at the same time share a single copy of the reference, which is also four "
+      "times smaller than the text version.\n"
+      "\n"
+      "Usage: ./make_2bit reference_fasta reference_2bit\n"
+      "Example: ./make_2bit hg38.fa hg38.2bit\n"
+      "\n"
+      "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
+    return -1;
+  } else if (argc != 3) {
+    std::cout << "make_2bit error: two arguments are required, the name of the reference (fasta) file "
+      "and the name of the 2bit file that is to be created.";
+    return -1;
+  } else {
+    std::string nameOfInputFile = argv[1];
+    std::string nameOfOutputFile = argv[2];
+    transformFile(nameOfInputFile, nameOfOutputFile);
+    return 0;
+  }
+}
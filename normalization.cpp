@@ -0,0 +1,333 @@
+#include "normalization.h"
+
+#include <cctype> // toupper
+#include <cstdlib> // atoi, abs
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "left_alignment.h"
+#include "symbolic_alleles.h"
+
+NormalizationSteps::NormalizationSteps(bool expandSymbolicAlleles, bool fixDeletionNotation, bool leftAlign) :
+  expandSymbolicAlleles_(expandSymbolicAlleles), fixDeletionNotation_(fixDeletionNotation), leftAlign_(leftAlign) {
+}
+
+/** Splits a string on a separator, so 4/5/3 split on '/' yields ["4","5","3"]. **/
+std::vector<std::string> splitOnSeparator(const std::string& str, char separator) {
+  std::vector<std::string> output;
+  size_t startSearchPos = 0;
+  while (true) {
+    size_t separatorPos = str.find(separator, startSearchPos);
+    output.push_back(str.substr(startSearchPos, separatorPos - startSearchPos));
+    if (separatorPos == std::string::npos) {
+      return output;
+    }
+    startSearchPos = separatorPos + 1;
+  }
+}
+
+std::string joinWithSeparator(const std::vector<std::string>& strings, char separator) {
+  std::string result = "";
+  for (int i = 0; i < strings.size(); ++i) {
+    if (i > 0) {
+      result += separator;
+    }
+    result += strings[i];
+  }
+  return result;
+}
+
+bool isDnaBase(char base) {
+  char baseInUpperCase = toupper(base);
+  return (baseInUpperCase == 'A' || baseInUpperCase == 'C' || baseInUpperCase == 'G' || baseInUpperCase == 'T');
+}
+
+NormalizableRecord::NormalizableRecord(const std::string& vcfLine) : line_(vcfLine), originalPosition_(0), position_(0) {
+  fieldStarts_[0] = 0;
+  for (int fieldIndex = 1; fieldIndex < 9; ++fieldIndex) {
+    size_t tabPosition = std::string::npos;
+    if (fieldStarts_[fieldIndex - 1] <= line_.length()) {
+      tabPosition = line_.find('\t', fieldStarts_[fieldIndex - 1]);
+    }
+    if (tabPosition == std::string::npos) {
+      if (fieldIndex < 5) {
+        error_ = "Normalization error: the line '" + line_ + "' is not a valid VCF record.";
+        return;
+      }
+      fieldStarts_[fieldIndex] = line_.length() + 1; // as if the line went on after a tab
+    } else {
+      fieldStarts_[fieldIndex] = tabPosition + 1;
+    }
+  }
+  chromosomeName_ = line_.substr(0, fieldStarts_[1] - 1);
+  originalPosition_ = atoi(line_.c_str() + fieldStarts_[1]);
+  position_ = originalPosition_;
+  referenceAllele_ = line_.substr(fieldStarts_[3], fieldStarts_[4] - 1 - fieldStarts_[3]);
+  alternativeAllele_ = line_.substr(fieldStarts_[4], fieldStarts_[5] - 1 - fieldStarts_[4]);
+}
+
+/**
+ * PacBio VCF files describe insertions as "T <INS>" with the inserted bases in SEQ=, and deletions as
+ * "T <DEL>" with their length in SVLEN= (or END=); the deleted bases are then taken from the reference.
+ * Records that lack the needed INFO field are left as they are. Note that this writes every deleted
+ * base into the VCF, so only ask for it when the full alleles are really needed; the tools that only
+ * need sizes and spans (compare, filter_eventtypes, size_ass, min_bedmaker) read them from the INFO field.
+ */
+void NormalizableRecord::expandSymbolicAlleles(const ReferenceSequence& chromosome) {
+  std::string info = "";
+  if (fieldStarts_[7] <= line_.length()) {
+    info = line_.substr(fieldStarts_[7], fieldStarts_[8] - 1 - fieldStarts_[7]);
+  }
+  if (alternativeAllele_ == "<INS>") {
+    std::string insertedBases;
+    if (!findInfoValue(info, "SEQ", insertedBases)) {
+      return;
+    }
+    // sometimes the alt starts with a different base than the ref...
+    alternativeAllele_ = referenceAllele_;
+    for (size_t i = 0; i < insertedBases.length() && isDnaBase(insertedBases[i]); ++i) {
+      alternativeAllele_ += toupper(insertedBases[i]);
+    }
+  } else if (alternativeAllele_ == "<DEL>") {
+    int svLength = getSymbolicEventSize(info, position_);
+    if (svLength < 0) {
+      return;
+    }
+    std::string deletedBases = chromosome.substr(position_ + 1, svLength);
+    for (int i = 0; i < deletedBases.length(); ++i) {
+      deletedBases[i] = toupper(deletedBases[i]);
+    }
+    alternativeAllele_ = referenceAllele_;
+    referenceAllele_ += deletedBases;
+  }
+}
+
+/**
+ * Some PacBio callers write a deletion as the deleted bases followed by the base after them, with as
+ * alternative allele the base before them ("chr1 10 AT C" instead of "chr1 9 CA C").
+ */
+void NormalizableRecord::fixDeletionNotation() {
+  bool isDeletion = (referenceAllele_.length() > 1 && alternativeAllele_.length() == 1);
+  if (!isDeletion) {
+    return;
+  }
+  --position_;
+  int eventLength = referenceAllele_.length() - alternativeAllele_.length();
+  referenceAllele_ = alternativeAllele_ + referenceAllele_.substr(0, eventLength);
+}
+
+bool NormalizableRecord::leftAlign(const ReferenceSequence& chromosome) {
+  std::vector<std::string> alleles = splitOnSeparator(alternativeAllele_, ',');
+  alleles.insert(alleles.begin(), referenceAllele_);
+  AlignmentResult result = normalizeAlleles(chromosome, position_, alleles);
+  if (result == REFERENCE_MISMATCH) {
+    // only a mismatching insertion or deletion stops the tool, as it always did; other records are
+    // written unchanged, with a "Can't handle" message
+    bool isInsertion = (referenceAllele_.length() == 1 && alleles.size() == 2 && alleles[1].length() > 1);
+    bool isDeletion = (referenceAllele_.length() > 1 && alleles.size() == 2 && alleles[1].length() == 1);
+    if (!isInsertion && !isDeletion) {
+      return false;
+    }
+    std::stringstream ss;
+    ss << "Event.leftAlign error: reference chromosome/pos " << chromosomeName_ << ":" << position_ <<
+      "[" << chromosome[position_] << "] and reference sequence [" << referenceAllele_[0] <<
+      "] don't seem to match.";
+    error_ = ss.str();
+    return true;
+  }
+  referenceAllele_ = alleles[0];
+  alleles.erase(alleles.begin());
+  alternativeAllele_ = joinWithSeparator(alleles, ',');
+  return result != SYMBOLIC_ALLELE;
+}
+
+const std::string& NormalizableRecord::getError() const {
+  return error_;
+}
+
+bool NormalizableRecord::isChanged() const {
+  return position_ != originalPosition_ ||
+    line_.compare(fieldStarts_[3], fieldStarts_[4] - 1 - fieldStarts_[3], referenceAllele_) != 0 ||
+    line_.compare(fieldStarts_[4], fieldStarts_[5] - 1 - fieldStarts_[4], alternativeAllele_) != 0;
+}
+
+std::string NormalizableRecord::asLine() const {
+  if (!isChanged()) {
+    return line_;
+  }
+  std::stringstream ss;
+  ss << position_;
+  std::string output;
+  output.reserve(line_.length() + referenceAllele_.length() + alternativeAllele_.length());
+  output.append(line_, 0, fieldStarts_[1]);
+  output += ss.str();
+  output.append(line_, fieldStarts_[2] - 1, fieldStarts_[3] - (fieldStarts_[2] - 1)); // the ID field and its tabs
+  output += referenceAllele_;
+  output += '\t';
+  output += alternativeAllele_;
+  if (fieldStarts_[5] <= line_.length()) {
+    output.append(line_, fieldStarts_[5] - 1, std::string::npos);
+  }
+  return output;
+}
+
+/**
+ * 'RecordBatch' holds consecutive records of a single chromosome, so they can be
+ * normalized by several threads at once and still be written in the original order.
+ */
+struct RecordBatch {
+  std::string chromosomeName_;
+  std::vector<std::string> lines_;
+  std::vector<std::string> normalizedLines_; // empty if the record is unchanged
+  std::vector<std::string> messages_; // "Can't handle" lines, empty if the record could be aligned
+  std::vector<std::string> errors_; // empty if the record could be normalized
+};
+
+// the number of records that is read before the worker threads normalize them
+const int MAXIMUM_BATCH_SIZE = 65536;
+
+/** Normalizes every numberOfThreads-th record of the batch, starting at firstIndex. **/
+void normalizeRecords(const ReferenceSequence* chromosome, const NormalizationSteps* steps, RecordBatch* batch,
+    int firstIndex, int numberOfThreads) {
+  for (int recordIndex = firstIndex; recordIndex < batch->lines_.size(); recordIndex += numberOfThreads) {
+    NormalizableRecord record(batch->lines_[recordIndex]);
+    if (!record.getError().empty()) {
+      batch->errors_[recordIndex] = record.getError();
+      continue;
+    }
+    if (steps->expandSymbolicAlleles_) {
+      record.expandSymbolicAlleles(*chromosome);
+    }
+    if (steps->fixDeletionNotation_) {
+      record.fixDeletionNotation();
+    }
+    bool isAligned = !steps->leftAlign_ || record.leftAlign(*chromosome);
+    if (!record.getError().empty()) {
+      batch->errors_[recordIndex] = record.getError();
+      continue;
+    }
+    if (record.isChanged()) {
+      batch->normalizedLines_[recordIndex] = record.asLine();
+    }
+    if (!isAligned) {
+      batch->messages_[recordIndex] = "Can't handle " + record.asLine();
+    }
+  }
+}
+
+/**
+ * Normalizes the records of the batch (in parallel if more than one thread is used), writes them, and empties
+ * the batch. Errors are only reported here, after the workers have finished: the records before the first
+ * faulty one are written, the error is printed, and false is returned so that the tool can stop.
+ */
+bool processBatch(ReferenceGenome& referenceGenome, const NormalizationSteps& steps, RecordBatch& batch,
+    int numberOfThreads, std::ofstream& outputVcf) {
+  if (batch.lines_.empty()) {
+    return true;
+  }
+  const ReferenceSequence& chromosome = referenceGenome.getChromosome(batch.chromosomeName_);
+  batch.normalizedLines_.assign(batch.lines_.size(), "");
+  batch.messages_.assign(batch.lines_.size(), "");
+  batch.errors_.assign(batch.lines_.size(), "");
+  if (numberOfThreads == 1) {
+    normalizeRecords(&chromosome, &steps, &batch, 0, 1);
+  } else {
+    std::vector<std::thread> workers;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+      workers.push_back(std::thread(normalizeRecords, &chromosome, &steps, &batch, threadIndex, numberOfThreads));
+    }
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+      workers[threadIndex].join();
+    }
+  }
+  for (int recordIndex = 0; recordIndex < batch.lines_.size(); ++recordIndex) {
+    if (!batch.errors_[recordIndex].empty()) {
+      std::cerr << batch.errors_[recordIndex] << std::endl;
+      return false;
+    }
+    std::cout << batch.messages_[recordIndex];
+    const std::string& normalizedLine = batch.normalizedLines_[recordIndex];
+    outputVcf << (normalizedLine.empty() ? batch.lines_[recordIndex] : normalizedLine) << '\n';
+  }
+  batch.lines_.clear();
+  return true;
+}
+
+int runNormalization(const std::string& nameOfTool, const std::string& usage, NormalizationSteps steps,
+    int argc, char** argv) {
+  if (argc == 1) {
+    std::cout << usage;
+    return -1;
+  } else if (argc < 4) {
+    std::cout << nameOfTool << " error: three arguments are required, "
+      "the name of the input vcf file, the name of the reference (fasta) file, and "
+      "the name of the output vcf file that is to be created.";
+    return -1;
+  }
+
+  std::string nameOfInputVcf = argv[1];
+  std::string nameOfReference = argv[2];
+  std::string nameOfOutputVcf = argv[3];
+  bool useWindowedReference = false;
+  int numberOfThreads = 1;
+  for (int argumentIndex = 4; argumentIndex < argc; ++argumentIndex) {
+    std::string option = argv[argumentIndex];
+    if (option == "-w") {
+      useWindowedReference = true;
+    } else if (option == "-e") {
+      steps.expandSymbolicAlleles_ = true;
+    } else if (option == "-d") {
+      steps.fixDeletionNotation_ = true;
+    } else if (option == "-a") {
+      steps.leftAlign_ = true;
+    } else if (option == "-t" && argumentIndex + 1 < argc) {
+      ++argumentIndex;
+      numberOfThreads = atoi(argv[argumentIndex]);
+      if (numberOfThreads < 1) {
+        std::cout << nameOfTool << " error: the number of threads should be at least 1." << std::endl;
+        return -1;
+      }
+    } else {
+      std::cout << nameOfTool << " error: unknown option " << option << std::endl;
+      return -1;
+    }
+  }
+  if (!steps.expandSymbolicAlleles_ && !steps.fixDeletionNotation_ && !steps.leftAlign_) {
+    steps.leftAlign_ = true; // left-aligning is what is needed most often
+  }
+
+  std::cout << "input VCF: " << nameOfInputVcf << std::endl;
+
+  std::string line = "";
+  std::ifstream inputVcf(nameOfInputVcf.c_str());
+  ReferenceGenome referenceGenome(nameOfReference, useWindowedReference);
+  std::ofstream outputVcf(nameOfOutputVcf.c_str());
+  RecordBatch batch;
+
+  while (!inputVcf.eof()) {
+    getline(inputVcf, line);
+    if (line.length() == 0) {
+      break; // we're done
+    }
+    if (line[0] == '#') {
+      // this is a comment line, copy comment lines directly to the output
+      if (!processBatch(referenceGenome, steps, batch, numberOfThreads, outputVcf)) {
+        return -1;
+      }
+      outputVcf << line << std::endl;
+      referenceGenome.addExpectedChromosome(getContigId(line)); // so the next chromosome can be prefetched
+    } else {
+      std::string chromosomeName = line.substr(0, line.find('\t'));
+      if (chromosomeName != batch.chromosomeName_ || batch.lines_.size() == MAXIMUM_BATCH_SIZE) {
+        if (!processBatch(referenceGenome, steps, batch, numberOfThreads, outputVcf)) {
+          return -1;
+        }
+        batch.chromosomeName_ = chromosomeName;
+      }
+      batch.lines_.push_back(line);
+    }
+  }
+  return processBatch(referenceGenome, steps, batch, numberOfThreads, outputVcf) ? 0 : -1;
+}
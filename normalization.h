@@ -0,0 +1,61 @@
+#ifndef NORMALIZATION_H
+#define NORMALIZATION_H
+
+#include <string>
+#include <vector>
+
+#include "reference.h"
+
+/**
+ * The steps with which normalize (and left_align, del_corr and standardize,
+ * which are normalize with fixed steps) can rewrite each record. They are
+ * applied in this order, in a single pass over the VCF file.
+ */
+struct NormalizationSteps {
+  NormalizationSteps(bool expandSymbolicAlleles, bool fixDeletionNotation, bool leftAlign);
+
+  bool expandSymbolicAlleles_; // "T <INS>" / "T <DEL>" (PacBio) into full alleles, using SEQ= and SVLEN=
+  bool fixDeletionNotation_; // deletions written as "chr1 10 AT C" into "chr1 9 CA C"
+  bool leftAlign_; // left-align and trim all records without symbolic alleles
+};
+
+/**
+ * 'NormalizableRecord' is a VCF record whose position and alleles can be
+ * rewritten by the normalization steps. The record does not copy the line,
+ * which must outlive it; it only notes where the fields are, so writing it
+ * back means splicing the new POS, REF and ALT into the otherwise untouched
+ * line, however many sample columns follow.
+ */
+class NormalizableRecord {
+public:
+  NormalizableRecord(const std::string& vcfLine);
+
+  void expandSymbolicAlleles(const ReferenceSequence& chromosome);
+  void fixDeletionNotation();
+  // returns false if the record cannot be aligned: it has a symbolic allele, or it is not an insertion or
+  // deletion and its REF does not match the reference
+  bool leftAlign(const ReferenceSequence& chromosome);
+  // the error found while reading or aligning the record (an invalid line, or an insertion or deletion
+  // whose REF does not match the reference), or "" if there was none. Errors are not reported here, as records may be normalized
+  // on worker threads; the caller reports them and stops
+  const std::string& getError() const;
+  bool isChanged() const;
+  std::string asLine() const;
+
+private:
+  const std::string& line_;
+  size_t fieldStarts_[9]; // where the first eight fields and the rest of the line start
+  int originalPosition_;
+  std::string chromosomeName_;
+  int position_;
+  std::string referenceAllele_;
+  std::string alternativeAllele_;
+  std::string error_;
+};
+
+// runs a normalization tool: reads the arguments (input VCF, reference, output VCF, options), and
+// writes the normalized VCF. Returns the exit code of the tool
+int runNormalization(const std::string& nameOfTool, const std::string& usage, NormalizationSteps steps,
+  int argc, char** argv);
+
+#endif // NORMALIZATION_H
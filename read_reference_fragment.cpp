@@ -1,28 +1,28 @@
 /** 
   read_reference
     
-  Purpose: Finds a certain region in the reference genome.
+  Purpose: Finds a certain region in the reference genome, or all regions in a BED file or
+  region list (lines like "chr1:1020-1040").
   
-  Usage: ./read_reference chromosome start_pos end_pos reference_fasta
+  Usage: ./read_reference chromosome start_pos end_pos reference
+     or: ./read_reference regions_file reference
   Example: ./read_reference chr1 1020 1040 hg38.fa
+  Example: ./read_reference candidate_flanks.bed hg38.2bit
+
+  The reference can be a 2bit file (see make_2bit) or a FASTA file, which is indexed
+  (like by samtools faidx) the first time it is used, so every region is read directly.
 
   Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
   
+#include <cctype> // toupper
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 
-const std::string load(const std::string nameOfChromosome, std::ifstream& genomeFile, std::string& outputSequence);
-
-void finalizeRegion(const std::string& nameOfCurrentChromosome, bool isNRegion, int lastSwapPosition, int newSwapPosition) {
-  if (nameOfCurrentChromosome != "") {
-    std::cout << nameOfCurrentChromosome << "\t" << lastSwapPosition << "\t" << newSwapPosition << "\t";
-    std::cout << (isNRegion ? "unknown" : "genomic") << std::endl;
-  }
-}
+#include "reference.h"
 
 std::string intToString(int i) {
   std::stringstream ss;
@@ -32,25 +32,76 @@ std::string intToString(int i) {
   return str;
 }
 
-std::string getChromosomeName(const std::string& line) {
-  std::stringstream ss;
-  ss << line;
-  std::string chromosomeName;
-  ss >> chromosomeName;
-  chromosomeName = chromosomeName.substr(1); // skip '>'
-  return chromosomeName;
+/** Writes the region like "1020: ACGTA CGTAC" with the last digit of each position above its base. **/
+void printRegion(const std::string& startPosAsString, int startPos, int endPos, const std::string& bases) {
+  std::string bottomline = startPosAsString + ":";
+  std::string topline = "";
+  for (int i = 0; i < bottomline.length(); i++ ) {
+    topline += " ";
+  }
+  for (int position = startPos; position < endPos; ++position) {
+    topline += intToString(position % 10);
+    bottomline += toupper(bases[position - startPos]);
+    if (position % 5 == 0) {
+      topline += " ";
+      bottomline += " ";
+    }
+  }
+  std::cout << topline << std::endl;
+  std::cout << bottomline << std::endl;
 }
 
-bool isConsistent(char ch, bool isNRegion) {
-  char upCh = toupper(ch);
-  if (ch == 'N') {
-    return isNRegion;
-  } else if (ch == 'A' || ch == 'C' || ch == 'G' || ch == 'T') {
-    return !isNRegion;
-  } else {
-    //std::cout << "Unknown character " << ch << std::endl;
-    return true; // no phase swap used
-  } 
+/** Prints the bases at positions startPos up to (but not including) endPos. **/
+void printRegion(ReferenceGenome& referenceGenome, const std::string& nameOfChromosome, int startPos, int endPos) {
+  const ReferenceSequence& chromosome = referenceGenome.getChromosome(nameOfChromosome);
+  if (endPos > chromosome.length() + 1) {
+    endPos = chromosome.length() + 1;
+  }
+  if (startPos < 1 || endPos <= startPos) {
+    std::cerr << "read_reference error: invalid region " << nameOfChromosome << " " << startPos << " " << endPos << std::endl;
+    return;
+  }
+  printRegion(intToString(startPos), startPos, endPos, chromosome.substr(startPos, endPos - startPos));
+}
+
+/**
+ * Prints every region in the file, which may be a BED file (0-based start, end), or
+ * a list of regions like "chr1:1020-1040" (1-based, including the end, like samtools).
+ */
+void printRegions(ReferenceGenome& referenceGenome, const std::string& nameOfRegionsFile) {
+  std::ifstream regionsFile(nameOfRegionsFile.c_str());
+  if (!regionsFile.is_open()) {
+    std::cerr << "read_reference error: cannot open " << nameOfRegionsFile << std::endl;
+    exit(-1);
+  }
+  std::string line;
+  while (getline(regionsFile, line)) {
+    if (line.length() == 0 || line[0] == '#' || line.compare(0, 5, "track") == 0 || line.compare(0, 7, "browser") == 0) {
+      continue;
+    }
+    std::stringstream ss;
+    ss << line;
+    std::string nameOfChromosome;
+    ss >> nameOfChromosome;
+    int startPos;
+    int endPos;
+    size_t colonPos = nameOfChromosome.find_last_of(':');
+    size_t dashPos = nameOfChromosome.find_last_of('-');
+    if (ss >> startPos >> endPos) {
+      // BED line: [start, end) in 0-based coordinates is [start + 1, end + 1) in 1-based coordinates
+      ++startPos;
+      ++endPos;
+    } else if (colonPos != std::string::npos && dashPos != std::string::npos && dashPos > colonPos) {
+      startPos = atoi(nameOfChromosome.substr(colonPos + 1, dashPos - colonPos - 1).c_str());
+      endPos = atoi(nameOfChromosome.substr(dashPos + 1).c_str()) + 1;
+      nameOfChromosome = nameOfChromosome.substr(0, colonPos);
+    } else {
+      std::cerr << "read_reference error: cannot interpret region " << line << std::endl;
+      continue;
+    }
+    std::cout << nameOfChromosome << ":" << startPos << "-" << endPos - 1 << std::endl;
+    printRegion(referenceGenome, nameOfChromosome, startPos, endPos);
+  }
 }
 
 int main(int argc, char** argv) {
@@ -58,81 +109,39 @@ int main(int argc, char** argv) {
     std::cout << 
       "read_reference\n"
       "\n"
-      "Purpose: Finds a certain region in the reference genome.\n"
+      "Purpose: Finds a certain region in the reference genome, or all regions in a BED file or "
+      "region list (lines like \"chr1:1020-1040\").\n"
       "\n"
-      "Usage: ./read_reference chromosome start_pos end_pos reference_fasta\n"
+      "Usage: ./read_reference chromosome start_pos end_pos reference\n"
+      "   or: ./read_reference regions_file reference\n"
       "Example: ./read_reference chr1 1020 1040 hg38.fa\n"
+      "Example: ./read_reference candidate_flanks.bed hg38.2bit\n"
+      "\n"
+      "The reference can be a 2bit file (see make_2bit) or a FASTA file, which is indexed "
+      "(like by samtools faidx) the first time it is used, so every region is read directly.\n"
       "\n"
       "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
     return -1;
-  } else if (argc != 5) {
+  } else if (argc != 5 && argc != 3) {
     std::cout << "read_reference error: four arguments are required, the name of the chromosome, "
-      "the start and end positions, and the name of the reference (fasta) file.";
+      "the start and end positions, and the name of the reference (fasta) file; or two arguments, "
+      "the name of a regions (BED) file and the name of the reference file.";
     return -1;
   }
+
+  if (argc == 3) {
+    std::string nameOfRegionsFile = argv[1];
+    std::string nameOfReference = argv[2];
+    ReferenceGenome referenceGenome(nameOfReference, true);
+    printRegions(referenceGenome, nameOfRegionsFile);
+    return 0;
+  }
   
   const std::string nameOfTargetChromosome = argv[1];
   int startPos = atoi(argv[2]);
   int endPos = atoi(argv[3]);
   std::string nameOfReference = argv[4];
-  std::string sequenceOfCurrentChromosome = "";
-  std::string line = "";
-  //std::cout << "S:" << startPos << ", E: " << endPos << std::endl;
-  //char ch;
-  //std::cin >> ch;
-		
-  std::ifstream genomeFile(nameOfReference.c_str());
-
-  std::string nameOfCurrentChromosome = "";
-
-  bool outputBase = false;
-  std::string startPosAsString = argv[2];
-  std::string bottomline = startPosAsString + ":";
-  std::string topline = "";
-  for (int i = 0; i < bottomline.length(); i++ ) {
-    topline += " ";
-  }
-  while (!genomeFile.eof()) {
-    getline(genomeFile, line);
-   
-    if (line.length() == 0) {
-      break;
-    }
-    if (line[0] == '>') {
-      // a new chromosome!
-      //std::cout << line << std::endl;
-      nameOfCurrentChromosome = getChromosomeName(line);
-      //std::cout << "CC: [" << nameOfCurrentChromosome <<"], TC:[" << nameOfTargetChromosome <<"]" << (nameOfCurrentChromosome == nameOfTargetChromosome? "Y" : "N") << std::endl;
-//char ch;
-  //std::cin >> ch;
-      sequenceOfCurrentChromosome = "N"; // to make C++ coordinates correspond to biological coordinates
-    } else {
-      // this is a regular line
-      
-      for (int i = 0; i < line.length(); ++i ) {
-        if (nameOfCurrentChromosome == nameOfTargetChromosome) {
-          //std::cout << sequenceOfCurrentChromosome.length() << ":" << line << std::endl;
-          int position = sequenceOfCurrentChromosome.length();
-          if (position == startPos) {
-            outputBase = true;
-          } else if (position == endPos) {
-            outputBase = false;
-            std::cout << topline << std::endl;
-            std::cout << bottomline << std::endl;
-            exit(0);
-          }
-          char newBase = toupper(line[i]);  
-          sequenceOfCurrentChromosome += newBase;
-          if (outputBase) {
-            topline += intToString(position % 10);
-            bottomline += newBase;
-            if (position % 5 == 0) {
-              topline += " ";
-              bottomline += " ";
-            }
-          }  
-        } 
-      } // loop over all bases
-    } // process a line
-  } // while there is still data in the reference
+  ReferenceGenome referenceGenome(nameOfReference, true);
+  printRegion(referenceGenome, nameOfTargetChromosome, startPos, endPos);
+  return 0;
 }
@@ -0,0 +1,698 @@
+#include <algorithm> // min
+#include <cctype> // isspace, tolower
+#include <cstdlib> // exit
+#include <cstring> // memcpy
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "reference.h"
+
+
+std::string ReferenceSequence::substr(int startPosition, int numberOfBases) const {
+  std::string result;
+  result.reserve(numberOfBases);
+  for (int position = startPosition; position < startPosition + numberOfBases; ++position) {
+    result += (*this)[position];
+  }
+  return result;
+}
+
+
+StringSequence::StringSequence() : sequence_("") {
+}
+
+char StringSequence::operator[](int position) const {
+  if (position < 1 || position >= (int)sequence_.length()) {
+    return 'N';
+  }
+  return sequence_[position];
+}
+
+int StringSequence::length() const {
+  return (sequence_.length() == 0) ? 0 : sequence_.length() - 1; // don't count the dummy 'N'
+}
+
+std::string& StringSequence::sequence() {
+  return sequence_;
+}
+
+
+TwoBitSequence::TwoBitSequence() :
+  sequenceId_(0), length_(0), isByteSwapped_(false), nBlockStarts_(NULL), nBlockSizes_(NULL), numberOfNBlocks_(0),
+  maskBlockStarts_(NULL), maskBlockSizes_(NULL), numberOfMaskBlocks_(0), packedDna_(NULL) {
+}
+
+unsigned int TwoBitSequence::readWord(const unsigned char* location) const {
+  unsigned int word;
+  memcpy(&word, location, sizeof(word)); // the tables in a 2bit file are not necessarily aligned
+  return isByteSwapped_ ? __builtin_bswap32(word) : word;
+}
+
+/**
+ * Is the 0-based offset inside one of the (sorted, non-overlapping) blocks? Lookups mostly follow each
+ * other closely, so the block or gap of the previous lookup is checked before the blocks are searched.
+ */
+bool TwoBitSequence::isInBlock(const unsigned char* blockStarts, const unsigned char* blockSizes,
+    int numberOfBlocks, unsigned int offset, BlockRun& lastRun) const {
+  if (lastRun.sequenceId_ == sequenceId_ && lastRun.blockStarts_ == blockStarts && lastRun.start_ <= offset &&
+      offset < lastRun.end_) {
+    return lastRun.isInBlock_;
+  }
+  // find the last block that starts at or before the offset
+  int low = 0;
+  int high = numberOfBlocks;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (readWord(blockStarts + 4 * middle) <= offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  lastRun.sequenceId_ = sequenceId_;
+  lastRun.blockStarts_ = blockStarts;
+  lastRun.start_ = 0;
+  lastRun.end_ = (low < numberOfBlocks) ? readWord(blockStarts + 4 * low) : std::numeric_limits<unsigned int>::max();
+  lastRun.isInBlock_ = false;
+  if (low > 0) {
+    unsigned int blockStart = readWord(blockStarts + 4 * (low - 1));
+    unsigned int blockSize = readWord(blockSizes + 4 * (low - 1));
+    if (offset - blockStart < blockSize) {
+      lastRun.start_ = blockStart;
+      lastRun.end_ = blockStart + blockSize;
+      lastRun.isInBlock_ = true;
+    } else {
+      lastRun.start_ = blockStart + blockSize;
+    }
+  }
+  return lastRun.isInBlock_;
+}
+
+char TwoBitSequence::operator[](int position) const {
+  if (position < 1 || position > length_) {
+    return 'N';
+  }
+  // per thread, as the worker threads of a tool share the sequence
+  static thread_local BlockRun lastNBlockRun;
+  static thread_local BlockRun lastMaskBlockRun;
+  unsigned int offset = position - 1;
+  if (numberOfNBlocks_ > 0 && isInBlock(nBlockStarts_, nBlockSizes_, numberOfNBlocks_, offset, lastNBlockRun)) {
+    return 'N';
+  }
+  // four bases per byte, the first base in the most significant bits
+  char base = "TCAG"[(packedDna_[offset >> 2] >> (6 - 2 * (offset & 3))) & 3];
+  if (numberOfMaskBlocks_ > 0 &&
+      isInBlock(maskBlockStarts_, maskBlockSizes_, numberOfMaskBlocks_, offset, lastMaskBlockRun)) {
+    base = tolower(base);
+  }
+  return base;
+}
+
+int TwoBitSequence::length() const {
+  return length_;
+}
+
+
+TwoBitFile::TwoBitFile(const std::string& fileName) : fileName_(fileName), data_(NULL), fileSize_(0),
+    isByteSwapped_(false) {
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  struct stat fileStatus;
+  if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0) {
+    std::cerr << "TwoBitFile error: cannot open " << fileName << std::endl;
+    exit(-1);
+  }
+  fileSize_ = fileStatus.st_size;
+  if (fileSize_ < 16) {
+    std::cerr << "TwoBitFile error: " << fileName << " is too short to be a 2bit file." << std::endl;
+    exit(-1);
+  }
+  void* mapping = mmap(NULL, fileSize_, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+  close(fileDescriptor);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "TwoBitFile error: cannot map " << fileName << " into memory." << std::endl;
+    exit(-1);
+  }
+  data_ = static_cast<const unsigned char*>(mapping);
+
+  // header: signature, version, number of sequences, reserved
+  isByteSwapped_ = (readWord(0) != TWO_BIT_SIGNATURE);
+  if (readWord(0) != TWO_BIT_SIGNATURE) {
+    std::cerr << "TwoBitFile error: " << fileName << " is not a 2bit file." << std::endl;
+    exit(-1);
+  }
+  unsigned int version = readWord(4);
+  unsigned int numberOfSequences = readWord(8);
+
+  // index: per sequence the length of its name, its name, and the offset of its data
+  size_t indexPosition = 16;
+  for (unsigned int sequenceIndex = 0; sequenceIndex < numberOfSequences; ++sequenceIndex) {
+    requireBytes(indexPosition, 1, "index");
+    int nameLength = data_[indexPosition];
+    requireBytes(indexPosition + 1, nameLength + ((version == 1) ? 8 : 4), "index");
+    std::string name(reinterpret_cast<const char*>(data_ + indexPosition + 1), nameLength);
+    indexPosition += 1 + nameLength;
+    size_t offset = readWord(indexPosition);
+    indexPosition += 4;
+    if (version == 1) {
+      // version 1 files have 64-bit offsets
+      size_t secondWord = readWord(indexPosition);
+      offset = isByteSwapped_ ? ((offset << 32) | secondWord) : ((secondWord << 32) | offset);
+      indexPosition += 4;
+    }
+    requireBytes(offset, 8, "sequence record of " + name);
+    sequenceOffsets_[name] = offset;
+    sequenceNames_.push_back(name);
+  }
+}
+
+TwoBitFile::~TwoBitFile() {
+  munmap(const_cast<unsigned char*>(data_), fileSize_);
+}
+
+/** Exits with an error message if the file does not contain the given byte range **/
+void TwoBitFile::requireBytes(size_t offset, size_t numberOfBytes, const std::string& description) const {
+  if (offset > fileSize_ || numberOfBytes > fileSize_ - offset) {
+    std::cerr << "TwoBitFile error: " << fileName_ << " is truncated or corrupt; its " << description
+      << " lies beyond the end of the file." << std::endl;
+    exit(-1);
+  }
+}
+
+unsigned int TwoBitFile::readWord(size_t offset) const {
+  unsigned int word;
+  memcpy(&word, data_ + offset, sizeof(word));
+  return isByteSwapped_ ? __builtin_bswap32(word) : word;
+}
+
+/**
+ * Lets 'sequence' refer to the chromosome with the given name, returns false
+ * if the file does not contain that chromosome.
+ */
+bool TwoBitFile::findSequence(const std::string& nameOfChromosome, TwoBitSequence& sequence) const {
+  std::map<std::string, size_t>::const_iterator offsetIt = sequenceOffsets_.find(nameOfChromosome);
+  if (offsetIt == sequenceOffsets_.end()) {
+    sequence = TwoBitSequence();
+    return false;
+  }
+  // the counts are 32-bit words, so the table sizes computed from them cannot overflow a size_t
+  const std::string description = "sequence record of " + nameOfChromosome;
+  size_t position = offsetIt->second;
+  sequence.isByteSwapped_ = isByteSwapped_;
+  unsigned int length = readWord(position);
+  unsigned int numberOfNBlocks = readWord(position + 4);
+  position += 8;
+  requireBytes(position, 8 * (size_t)numberOfNBlocks + 4, description);
+  sequence.nBlockStarts_ = data_ + position;
+  sequence.nBlockSizes_ = data_ + position + 4 * (size_t)numberOfNBlocks;
+  position += 8 * (size_t)numberOfNBlocks;
+  unsigned int numberOfMaskBlocks = readWord(position);
+  position += 4;
+  requireBytes(position, 8 * (size_t)numberOfMaskBlocks + 4 + ((size_t)length + 3) / 4, description);
+  sequence.maskBlockStarts_ = data_ + position;
+  sequence.maskBlockSizes_ = data_ + position + 4 * (size_t)numberOfMaskBlocks;
+  position += 8 * (size_t)numberOfMaskBlocks;
+  position += 4; // reserved word
+  sequence.packedDna_ = data_ + position;
+  if (length > (unsigned int)std::numeric_limits<int>::max()) {
+    std::cerr << "TwoBitFile error: " << nameOfChromosome << " in " << fileName_
+      << " is longer than the supported maximum of " << std::numeric_limits<int>::max() << " bases." << std::endl;
+    exit(-1);
+  }
+  static std::atomic<unsigned long long> numberOfFoundSequences(0);
+  sequence.sequenceId_ = ++numberOfFoundSequences;
+  sequence.length_ = length;
+  sequence.numberOfNBlocks_ = numberOfNBlocks;
+  sequence.numberOfMaskBlocks_ = numberOfMaskBlocks;
+  return true;
+}
+
+/**
+ * Asks the OS to start reading the packed bases of the given chromosome into the
+ * page cache, so that they are (mostly) present by the time they are needed.
+ */
+void TwoBitFile::prefetchSequence(const std::string& nameOfChromosome) const {
+  TwoBitSequence sequence;
+  if (!findSequence(nameOfChromosome, sequence)) {
+    return;
+  }
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t startOfRange = (sequence.packedDna_ - data_) / pageSize * pageSize;
+  size_t endOfRange = (sequence.packedDna_ - data_) + (sequence.length_ + 3) / 4;
+  madvise(const_cast<unsigned char*>(data_) + startOfRange, endOfRange - startOfRange, MADV_WILLNEED);
+}
+
+std::string TwoBitFile::getNameOfNextSequence(const std::string& nameOfChromosome) const {
+  for (int i = 0; i + 1 < sequenceNames_.size(); ++i) {
+    if (sequenceNames_[i] == nameOfChromosome) {
+      return sequenceNames_[i + 1];
+    }
+  }
+  return "";
+}
+
+/** Does the file start with the signature of a 2bit file (in either byte order)? **/
+bool isTwoBitFile(const std::string& fileName) {
+  std::ifstream file(fileName.c_str(), std::ios::binary);
+  unsigned int signature = 0;
+  file.read(reinterpret_cast<char*>(&signature), sizeof(signature));
+  return file && (signature == TWO_BIT_SIGNATURE || __builtin_bswap32(signature) == TWO_BIT_SIGNATURE);
+}
+
+
+WindowedSequence::WindowedSequence() : fasta_(NULL), sequenceId_(0), sequenceIndex_(0), length_(0) {
+}
+
+char WindowedSequence::operator[](int position) const {
+  if (fasta_ == NULL || position < 1 || position > length_) {
+    return 'N';
+  }
+  // per thread, as the worker threads of a tool share the sequence
+  static thread_local LastPage lastPage;
+  int offset = position - 1;
+  int pageIndex = offset / PAGE_SIZE_IN_BASES;
+  if (lastPage.sequenceId_ != sequenceId_ || lastPage.pageIndex_ != pageIndex) {
+    lastPage.bases_ = fasta_->getPage(sequenceIndex_, pageIndex);
+    lastPage.sequenceId_ = sequenceId_;
+    lastPage.pageIndex_ = pageIndex;
+  }
+  return (*lastPage.bases_)[offset % PAGE_SIZE_IN_BASES];
+}
+
+int WindowedSequence::length() const {
+  return length_;
+}
+
+std::string WindowedSequence::substr(int startPosition, int numberOfBases) const {
+  if (fasta_ == NULL) {
+    return std::string(numberOfBases, 'N');
+  }
+  return fasta_->getBases(sequenceIndex_, startPosition, numberOfBases);
+}
+
+
+IndexedFasta::IndexedFasta(const std::string& fileName) : fileName_(fileName) {
+  entries_ = readFastaIndex(fileName);
+  for (int i = 0; i < entries_.size(); ++i) {
+    entryIndices_[entries_[i].name_] = i;
+  }
+  fileDescriptor_ = open(fileName.c_str(), O_RDONLY);
+  if (fileDescriptor_ < 0) {
+    std::cerr << "IndexedFasta error: cannot open " << fileName << std::endl;
+    exit(-1);
+  }
+}
+
+IndexedFasta::~IndexedFasta() {
+  close(fileDescriptor_);
+}
+
+bool IndexedFasta::findSequence(const std::string& nameOfChromosome, WindowedSequence& sequence) {
+  std::map<std::string, int>::const_iterator entryIt = entryIndices_.find(nameOfChromosome);
+  if (entryIt == entryIndices_.end()) {
+    sequence = WindowedSequence();
+    return false;
+  }
+  static std::atomic<unsigned long long> numberOfFoundSequences(0);
+  sequence.fasta_ = this;
+  sequence.sequenceId_ = ++numberOfFoundSequences;
+  sequence.sequenceIndex_ = entryIt->second;
+  sequence.length_ = entries_[entryIt->second].length_;
+  return true;
+}
+
+std::shared_ptr<const std::string> IndexedFasta::getPage(int sequenceIndex, int pageIndex) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return getCachedPage(sequenceIndex, pageIndex);
+}
+
+std::string IndexedFasta::getBases(int sequenceIndex, int startPosition, int numberOfBases) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string bases;
+  bases.reserve(numberOfBases);
+  long long length = entries_[sequenceIndex].length_;
+  int position = startPosition;
+  while (position < startPosition + numberOfBases) {
+    if (position < 1 || position > length) {
+      bases += 'N';
+      ++position;
+      continue;
+    }
+    int offset = position - 1;
+    const std::string& page = *getCachedPage(sequenceIndex, offset / PAGE_SIZE_IN_BASES);
+    int offsetInPage = offset % PAGE_SIZE_IN_BASES;
+    int basesFromPage = std::min((int)page.length() - offsetInPage, startPosition + numberOfBases - position);
+    bases.append(page, offsetInPage, basesFromPage);
+    position += basesFromPage;
+  }
+  return bases;
+}
+
+/** Returns the requested page, reading it if it is not cached; the caller must hold the mutex. **/
+const std::shared_ptr<const std::string>& IndexedFasta::getCachedPage(int sequenceIndex, int pageIndex) {
+  long long key = ((long long)sequenceIndex << 32) | pageIndex;
+  std::map<long long, std::list<Page>::iterator>::iterator lookupIt = pageLookup_.find(key);
+  if (lookupIt != pageLookup_.end()) {
+    pages_.splice(pages_.begin(), pages_, lookupIt->second); // now the most recently used page
+    return pages_.front().bases_;
+  }
+  if (pages_.size() >= MAXIMUM_NUMBER_OF_CACHED_PAGES) {
+    pageLookup_.erase(pages_.back().key_);
+    pages_.pop_back();
+  }
+  std::shared_ptr<std::string> bases = std::make_shared<std::string>();
+  readPage(sequenceIndex, pageIndex, *bases);
+  pages_.push_front(Page());
+  pages_.front().key_ = key;
+  pages_.front().bases_ = bases;
+  pageLookup_[key] = pages_.begin();
+  return pages_.front().bases_;
+}
+
+void IndexedFasta::readPage(int sequenceIndex, int pageIndex, std::string& bases) const {
+  const FastaIndexEntry& entry = entries_[sequenceIndex];
+  long long firstBase = (long long)pageIndex * PAGE_SIZE_IN_BASES;
+  long long lastBase = std::min(firstBase + PAGE_SIZE_IN_BASES, entry.length_) - 1;
+  long long startInFile = entry.offset_ + (firstBase / entry.lineBases_) * entry.lineWidth_ + firstBase % entry.lineBases_;
+  long long endInFile = entry.offset_ + (lastBase / entry.lineBases_) * entry.lineWidth_ + lastBase % entry.lineBases_ + 1;
+
+  std::string buffer(endInFile - startInFile, '\0');
+  ssize_t bytesRead = pread(fileDescriptor_, &buffer[0], buffer.length(), startInFile);
+  if (bytesRead != (ssize_t)buffer.length()) {
+    std::cerr << "IndexedFasta error: cannot read from " << fileName_ << "; is its .fai index out of date?" << std::endl;
+    exit(-1);
+  }
+  bases.clear();
+  bases.reserve(lastBase - firstBase + 1);
+  for (int i = 0; i < buffer.length(); ++i) {
+    if (buffer[i] != '\n' && buffer[i] != '\r') {
+      bases += buffer[i];
+    }
+  }
+}
+
+/** Reads the .fai index of the FASTA file, creating the index first if needed. **/
+std::vector<FastaIndexEntry> readFastaIndex(const std::string& nameOfFasta) {
+  std::string nameOfIndex = nameOfFasta + ".fai";
+  std::ifstream indexFile(nameOfIndex.c_str());
+  if (!indexFile.is_open()) {
+    buildFastaIndex(nameOfFasta);
+    indexFile.open(nameOfIndex.c_str());
+  }
+  std::vector<FastaIndexEntry> entries;
+  std::string line;
+  while (getline(indexFile, line)) {
+    if (line.length() == 0) {
+      continue;
+    }
+    std::stringstream ss;
+    ss << line;
+    FastaIndexEntry entry;
+    ss >> entry.name_ >> entry.length_ >> entry.offset_ >> entry.lineBases_ >> entry.lineWidth_;
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+/**
+ * Creates a samtools-compatible .fai index next to the FASTA file. Like samtools,
+ * it requires all sequence lines of a chromosome except the last to be equally long.
+ */
+void buildFastaIndex(const std::string& nameOfFasta) {
+  std::cerr << "Indexing " << nameOfFasta << std::endl;
+  std::ifstream fastaFile(nameOfFasta.c_str(), std::ios::binary);
+  if (!fastaFile.is_open()) {
+    std::cerr << "buildFastaIndex error: cannot open " << nameOfFasta << std::endl;
+    exit(-1);
+  }
+  std::vector<FastaIndexEntry> entries;
+  std::string line;
+  long long offsetInFile = 0;
+  bool sawShortLine = false;
+  while (getline(fastaFile, line)) {
+    long long offsetOfLine = offsetInFile;
+    offsetInFile += line.length() + 1;
+    if (line.length() > 0 && line[0] == '>') {
+      FastaIndexEntry entry;
+      entry.name_ = line.substr(1, line.find_first_of(" \t\r") - 1);
+      entry.length_ = 0;
+      entry.offset_ = offsetInFile;
+      entry.lineBases_ = 0;
+      entry.lineWidth_ = 0;
+      entries.push_back(entry);
+      sawShortLine = false;
+      continue;
+    }
+    if (entries.empty()) {
+      continue;
+    }
+    FastaIndexEntry& entry = entries.back();
+    int lineBases = line.length();
+    if (lineBases > 0 && line[lineBases - 1] == '\r') {
+      --lineBases;
+    }
+    if (entry.lineBases_ == 0) {
+      entry.offset_ = offsetOfLine;
+      entry.lineBases_ = lineBases;
+      entry.lineWidth_ = line.length() + 1;
+    } else if (sawShortLine || lineBases > entry.lineBases_) {
+      if (lineBases == 0) {
+        continue; // trailing empty line
+      }
+      std::cerr << "buildFastaIndex error: " << entry.name_ << " in " << nameOfFasta
+        << " has lines of different lengths, so it cannot be indexed." << std::endl;
+      exit(-1);
+    }
+    sawShortLine = sawShortLine || (lineBases < entry.lineBases_);
+    entry.length_ += lineBases;
+  }
+
+  std::string nameOfIndex = nameOfFasta + ".fai";
+  std::ofstream indexFile(nameOfIndex.c_str());
+  if (!indexFile.is_open()) {
+    std::cerr << "buildFastaIndex error: cannot create " << nameOfIndex << std::endl;
+    exit(-1);
+  }
+  for (int i = 0; i < entries.size(); ++i) {
+    indexFile << entries[i].name_ << "\t" << entries[i].length_ << "\t" << entries[i].offset_ << "\t"
+      << entries[i].lineBases_ << "\t" << entries[i].lineWidth_ << "\n";
+  }
+}
+
+
+ReferenceGenome::ReferenceGenome(const std::string& fileName, bool useWindowedAccess) :
+  fileName_(fileName), twoBitFile_(NULL), indexedFasta_(NULL), isPrefetchCancelled_(false) {
+  if (isTwoBitFile(fileName)) {
+    twoBitFile_ = new TwoBitFile(fileName);
+  } else if (useWindowedAccess) {
+    indexedFasta_ = new IndexedFasta(fileName);
+  } else {
+    fastaFile_.open(fileName.c_str());
+  }
+}
+
+ReferenceGenome::~ReferenceGenome() {
+  cancelPrefetch(); // the tool is done, so the next chromosome will not be needed
+  delete twoBitFile_;
+  delete indexedFasta_;
+}
+
+void ReferenceGenome::addExpectedChromosome(const std::string& nameOfChromosome) {
+  if (nameOfChromosome != "") {
+    expectedChromosomes_.push_back(nameOfChromosome);
+  }
+}
+
+const ReferenceSequence& ReferenceGenome::getChromosome(const std::string& nameOfChromosome) {
+  if (twoBitFile_ != NULL) {
+    if (nameOfChromosome != nameOfCurrentChromosome_) {
+      if (!twoBitFile_->findSequence(nameOfChromosome, twoBitSequence_)) {
+        std::cerr << "ReferenceGenome warning: chromosome " << nameOfChromosome << " not found in "
+          << fileName_ << std::endl;
+      }
+      nameOfCurrentChromosome_ = nameOfChromosome;
+      twoBitFile_->prefetchSequence(getNextExpectedChromosome(nameOfChromosome));
+    }
+    return twoBitSequence_;
+  }
+
+  if (indexedFasta_ != NULL) {
+    if (nameOfChromosome != nameOfCurrentChromosome_) {
+      if (!indexedFasta_->findSequence(nameOfChromosome, windowedSequence_)) {
+        std::cerr << "ReferenceGenome warning: chromosome " << nameOfChromosome << " not found in "
+          << fileName_ << std::endl;
+      }
+      nameOfCurrentChromosome_ = nameOfChromosome;
+    }
+    return windowedSequence_;
+  }
+
+  if (nameOfChromosome != nameOfCurrentChromosome_) {
+    if (nameOfChromosomeToPrefetch_ != nameOfChromosome) {
+      cancelPrefetch(); // the VCF does not follow the expected order, so don't wait for the wrong chromosome
+    } else {
+      waitForPrefetch();
+    }
+    if (nameOfPrefetchedChromosome_ == nameOfChromosome) {
+      fastaSequence_.sequence().swap(prefetchedSequence_);
+    } else {
+      loadFromFasta(nameOfChromosome, fastaSequence_.sequence());
+    }
+    nameOfPrefetchedChromosome_ = "";
+    prefetchedSequence_ = "";
+    if (fastaSequence_.sequence().length() == 0) {
+      std::cerr << "ReferenceGenome warning: chromosome " << nameOfChromosome << " not found in "
+        << fileName_ << std::endl;
+    }
+    nameOfCurrentChromosome_ = nameOfChromosome;
+    startPrefetch(getNextExpectedChromosome(nameOfChromosome));
+  }
+  return fastaSequence_;
+}
+
+void ReferenceGenome::loadFromFasta(const std::string& nameOfChromosome, std::string& outputSequence,
+    const std::atomic<bool>* isCancelled) {
+  load(nameOfChromosome, fastaFile_, outputSequence, isCancelled);
+
+  // the below deals with mismatching reference genome - VCF chromosome orders
+  if (outputSequence.length() == 0 && (isCancelled == NULL || !*isCancelled)) {
+    fastaFile_.close();
+    fastaFile_.clear();
+    fastaFile_.open(fileName_.c_str());
+    load(nameOfChromosome, fastaFile_, outputSequence, isCancelled);
+  }
+}
+
+/**
+ * Returns the chromosome that is expected to follow the given one, or "" if
+ * none is expected (the last chromosome of the VCF, or of the reference).
+ */
+std::string ReferenceGenome::getNextExpectedChromosome(const std::string& nameOfChromosome) {
+  for (int i = 0; i < expectedChromosomes_.size(); ++i) {
+    if (expectedChromosomes_[i] == nameOfChromosome) {
+      return (i + 1 < expectedChromosomes_.size()) ? expectedChromosomes_[i + 1] : "";
+    }
+  }
+  return (twoBitFile_ != NULL) ? twoBitFile_->getNameOfNextSequence(nameOfChromosome) :
+    peekNameOfNextFastaChromosome();
+}
+
+/**
+ * Returns the name in the header line at the current position of the FASTA file, where a load leaves it,
+ * without moving on; "" at the end of the file or if no header line is there.
+ */
+std::string ReferenceGenome::peekNameOfNextFastaChromosome() {
+  std::streampos position = fastaFile_.tellg();
+  if (position < 0) {
+    return "";
+  }
+  std::string line;
+  getline(fastaFile_, line);
+  fastaFile_.clear();
+  fastaFile_.seekg(position, fastaFile_.beg);
+  if (line.empty() || line[0] != '>') {
+    return "";
+  }
+  return line.substr(1, line.find_first_of(" \t\r") - 1);
+}
+
+void ReferenceGenome::startPrefetch(const std::string& nameOfChromosome) {
+  if (nameOfChromosome == "") {
+    return;
+  }
+  nameOfChromosomeToPrefetch_ = nameOfChromosome;
+  prefetchThread_ = std::thread(&ReferenceGenome::prefetch, this, nameOfChromosome);
+}
+
+/** Runs on the background thread; the main thread does not touch fastaFile_ until waitForPrefetch **/
+void ReferenceGenome::prefetch(const std::string& nameOfChromosome) {
+  loadFromFasta(nameOfChromosome, prefetchedSequence_, &isPrefetchCancelled_);
+  nameOfPrefetchedChromosome_ = (prefetchedSequence_.length() > 0) ? nameOfChromosome : "";
+  if (isPrefetchCancelled_) {
+    // the sequence may be incomplete
+    nameOfPrefetchedChromosome_ = "";
+    prefetchedSequence_ = "";
+  }
+}
+
+void ReferenceGenome::waitForPrefetch() {
+  if (prefetchThread_.joinable()) {
+    prefetchThread_.join();
+  }
+  nameOfChromosomeToPrefetch_ = "";
+}
+
+/** Stops the background load within a line of the FASTA file, and waits until it has stopped **/
+void ReferenceGenome::cancelPrefetch() {
+  isPrefetchCancelled_ = true;
+  waitForPrefetch();
+  isPrefetchCancelled_ = false;
+}
+
+std::string getContigId(const std::string& headerLine) {
+  const std::string contigStart = "##contig=<";
+  if (headerLine.compare(0, contigStart.length(), contigStart) != 0) {
+    return "";
+  }
+  size_t idStart = headerLine.find("ID=", contigStart.length());
+  if (idStart == std::string::npos) {
+    return "";
+  }
+  idStart += 3;
+  size_t idEnd = headerLine.find_first_of(",>", idStart);
+  return headerLine.substr(idStart, idEnd - idStart);
+}
+
+
+/**
+ * Loads a chromosome with the specified name into memory.
+ * @param nameOfChromosome
+ * 		The name of the chromosome which is sought
+ * @param genomeFile
+ * 		The file which houses the reference genome
+ * @param isCancelled
+ * 		If given and set (by another thread), reading stops after the current line.
+ * @return
+ * 		The sequence of the sought chromosome.
+ */
+const std::string load(const std::string nameOfChromosome, std::ifstream& genomeFile, std::string& outputSequence,
+    const std::atomic<bool>* isCancelled) {
+  outputSequence = "";
+  std::string soughtStartSequence = ">" + nameOfChromosome;
+  int startSequenceLength = soughtStartSequence.length();
+  std::string line;
+  bool copyLines = false;
+  std::streampos lastReadPosInFile;
+  while (!genomeFile.eof() && (isCancelled == NULL || !*isCancelled)) {
+    lastReadPosInFile = genomeFile.tellg();
+    getline(genomeFile, line);
+    if (line.length() == 0) {
+      break;
+    }
+    if (line[0] == '>') {
+      // two cases: either turn copying on, or turn it off.
+      if (line.compare(0, startSequenceLength, soughtStartSequence) == 0 &&
+          (line.length() == startSequenceLength || isspace(line[startSequenceLength]))) {
+        copyLines = true;
+        outputSequence += "N"; // for easy conversion of C++ coordinates to 1-based coordinates of most
+                               // references
+      } else { // >otherChromosomeName
+        if (copyLines) {
+          genomeFile.seekg(lastReadPosInFile, genomeFile.beg);
+          return outputSequence; // done
+        }
+      }
+    } else {
+      // is just a normal chromosome sequence
+      if (copyLines) {
+        outputSequence += line;
+      }
+    }
+  }
+  return outputSequence;
+}
@@ -0,0 +1,266 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 'ReferenceSequence' represents the sequence of one chromosome of the
+ * reference genome. Positions are 1-based, like in VCF files; position 0 and
+ * positions beyond the end of the chromosome yield 'N'.
+ */
+class ReferenceSequence {
+public:
+  virtual ~ReferenceSequence() {}
+  virtual char operator[](int position) const = 0;
+  virtual int length() const = 0;
+
+  // returns numberOfBases bases starting at (1-based) startPosition
+  virtual std::string substr(int startPosition, int numberOfBases) const;
+};
+
+/**
+ * A chromosome that has been read completely into memory, for example from a
+ * FASTA file. Like the old 'load' function, the stored sequence starts with a
+ * dummy 'N' so that string indices equal biological coordinates.
+ */
+class StringSequence : public ReferenceSequence {
+public:
+  StringSequence();
+  char operator[](int position) const;
+  int length() const;
+
+  std::string& sequence();
+
+private:
+  std::string sequence_;
+};
+
+/**
+ * A chromosome inside a memory-mapped 2bit file (see TwoBitFile). Bases are
+ * looked up directly in the packed data, so no memory is needed per process
+ * except for the pages of the file that the OS shares between all processes.
+ */
+class TwoBitSequence : public ReferenceSequence {
+public:
+  TwoBitSequence();
+  char operator[](int position) const;
+  int length() const;
+
+private:
+  friend class TwoBitFile;
+
+  // the run of offsets around the last lookup in a block table (a block, or the gap between two
+  // blocks), which gives the answer for the next offsets of an alignment without a search
+  struct BlockRun {
+    unsigned long long sequenceId_; // 0 if the run is not known yet
+    const unsigned char* blockStarts_;
+    unsigned int start_;
+    unsigned int end_;
+    bool isInBlock_;
+  };
+
+  bool isInBlock(const unsigned char* blockStarts, const unsigned char* blockSizes,
+    int numberOfBlocks, unsigned int offset, BlockRun& lastRun) const;
+  unsigned int readWord(const unsigned char* location) const;
+
+  unsigned long long sequenceId_; // unique per call of TwoBitFile::findSequence, to recognize cached runs
+  int length_;
+  bool isByteSwapped_;
+  const unsigned char* nBlockStarts_;
+  const unsigned char* nBlockSizes_;
+  int numberOfNBlocks_;
+  const unsigned char* maskBlockStarts_;
+  const unsigned char* maskBlockSizes_;
+  int numberOfMaskBlocks_;
+  const unsigned char* packedDna_;
+};
+
+/**
+ * A reference genome in the UCSC 2bit format (as produced by make_2bit or by
+ * UCSC's faToTwoBit), mapped read-only into memory: four bases per byte, plus
+ * a table of N-runs and a table of soft-masked (lowercase) runs per sequence.
+ */
+class TwoBitFile {
+public:
+  TwoBitFile(const std::string& fileName);
+  ~TwoBitFile();
+
+  bool findSequence(const std::string& nameOfChromosome, TwoBitSequence& sequence) const;
+  void prefetchSequence(const std::string& nameOfChromosome) const;
+  std::string getNameOfNextSequence(const std::string& nameOfChromosome) const;
+
+private:
+  TwoBitFile(const TwoBitFile&);
+  TwoBitFile& operator=(const TwoBitFile&);
+
+  void requireBytes(size_t offset, size_t numberOfBytes, const std::string& description) const;
+  unsigned int readWord(size_t offset) const;
+
+  std::string fileName_;
+  const unsigned char* data_;
+  size_t fileSize_;
+  bool isByteSwapped_;
+  std::map<std::string, size_t> sequenceOffsets_;
+  std::vector<std::string> sequenceNames_; // in the order of the file
+};
+
+class IndexedFasta;
+
+/**
+ * A chromosome inside an indexed FASTA file (see IndexedFasta). Bases are
+ * read on demand, a page at a time, so only the parts of the chromosome
+ * around the events are ever read from disk.
+ */
+class WindowedSequence : public ReferenceSequence {
+public:
+  WindowedSequence();
+  char operator[](int position) const;
+  int length() const;
+  std::string substr(int startPosition, int numberOfBases) const;
+
+private:
+  friend class IndexedFasta;
+
+  // the page of the last base that a thread looked up, so the next bases of that page skip the cache lock
+  struct LastPage {
+    unsigned long long sequenceId_; // 0 if no page is held yet
+    int pageIndex_;
+    std::shared_ptr<const std::string> bases_;
+  };
+
+  IndexedFasta* fasta_;
+  unsigned long long sequenceId_; // unique per call of IndexedFasta::findSequence, to recognize held pages
+  int sequenceIndex_;
+  int length_;
+};
+
+/** One line of a samtools-style .fai index **/
+struct FastaIndexEntry {
+  std::string name_;
+  long long length_;
+  long long offset_; // of the first base in the FASTA file
+  int lineBases_;
+  int lineWidth_; // lineBases_ plus the line ending
+};
+
+/**
+ * A FASTA file with a .fai index (which is created if it does not exist yet).
+ * Recently used pages of a fixed number of bases are kept in a small
+ * least-recently-used cache; the cache is shared by, and safe to use from,
+ * several threads.
+ */
+class IndexedFasta {
+public:
+  IndexedFasta(const std::string& fileName);
+  ~IndexedFasta();
+
+  bool findSequence(const std::string& nameOfChromosome, WindowedSequence& sequence);
+  // the bases of a page (0-based positions pageIndex * PAGE_SIZE_IN_BASES and on); the page stays valid
+  // for as long as the caller holds it, also after the cache has dropped it
+  std::shared_ptr<const std::string> getPage(int sequenceIndex, int pageIndex);
+  std::string getBases(int sequenceIndex, int startPosition, int numberOfBases);
+
+private:
+  IndexedFasta(const IndexedFasta&);
+  IndexedFasta& operator=(const IndexedFasta&);
+
+  struct Page {
+    long long key_;
+    std::shared_ptr<const std::string> bases_;
+  };
+
+  const std::shared_ptr<const std::string>& getCachedPage(int sequenceIndex, int pageIndex);
+  void readPage(int sequenceIndex, int pageIndex, std::string& bases) const;
+
+  std::string fileName_;
+  int fileDescriptor_;
+  std::vector<FastaIndexEntry> entries_;
+  std::map<std::string, int> entryIndices_;
+  std::list<Page> pages_; // the most recently used page first
+  std::map<long long, std::list<Page>::iterator> pageLookup_;
+  std::mutex mutex_;
+};
+
+// size of the pages in which an IndexedFasta reads its sequences, and the number of pages it caches
+const int PAGE_SIZE_IN_BASES = 16384;
+const int MAXIMUM_NUMBER_OF_CACHED_PAGES = 256;
+
+std::vector<FastaIndexEntry> readFastaIndex(const std::string& nameOfFasta);
+void buildFastaIndex(const std::string& nameOfFasta);
+
+// the signature with which each 2bit file starts
+const unsigned int TWO_BIT_SIGNATURE = 0x1A412743;
+
+bool isTwoBitFile(const std::string& fileName);
+
+/**
+ * 'ReferenceGenome' gives the tools access to the chromosomes of a reference
+ * genome, which can be either a FASTA file or a 2bit file. FASTA chromosomes
+ * are read into memory one at a time, 2bit chromosomes are only mapped.
+ * With 'useWindowedAccess', FASTA chromosomes are instead read page by page
+ * through an IndexedFasta, which suits VCF files with few events (panels,
+ * exomes) far better than loading whole chromosomes.
+ *
+ * While the tool works on one chromosome, the next chromosome is already read
+ * (FASTA) or paged in (2bit) in the background. The next chromosome is the
+ * next one in the order given by addExpectedChromosome (normally the ##contig
+ * lines of the VCF), or, if no order is given, the next one in the reference;
+ * for a FASTA file, its name is read from the header line that follows the
+ * current chromosome. A FASTA load that turns out to be unneeded, because the
+ * VCF continues with another chromosome or ends, is cancelled instead of
+ * waited for.
+ */
+class ReferenceGenome {
+public:
+  ReferenceGenome(const std::string& fileName, bool useWindowedAccess = false);
+  ~ReferenceGenome();
+
+  // the returned sequence remains valid until the next call of getChromosome
+  const ReferenceSequence& getChromosome(const std::string& nameOfChromosome);
+  void addExpectedChromosome(const std::string& nameOfChromosome);
+
+private:
+  ReferenceGenome(const ReferenceGenome&);
+  ReferenceGenome& operator=(const ReferenceGenome&);
+
+  void loadFromFasta(const std::string& nameOfChromosome, std::string& outputSequence,
+    const std::atomic<bool>* isCancelled = NULL);
+  std::string getNextExpectedChromosome(const std::string& nameOfChromosome);
+  std::string peekNameOfNextFastaChromosome();
+  void startPrefetch(const std::string& nameOfChromosome);
+  void prefetch(const std::string& nameOfChromosome);
+  void waitForPrefetch();
+  void cancelPrefetch();
+
+  std::string fileName_;
+  TwoBitFile* twoBitFile_;
+  TwoBitSequence twoBitSequence_;
+  IndexedFasta* indexedFasta_;
+  WindowedSequence windowedSequence_;
+  std::ifstream fastaFile_;
+  StringSequence fastaSequence_;
+  std::string nameOfCurrentChromosome_;
+  std::vector<std::string> expectedChromosomes_;
+
+  std::thread prefetchThread_;
+  std::atomic<bool> isPrefetchCancelled_;
+  std::string nameOfChromosomeToPrefetch_; // "" if none is being loaded
+  std::string nameOfPrefetchedChromosome_;
+  std::string prefetchedSequence_;
+};
+
+// returns the ID of a "##contig=<ID=chr1,...>" header line, or "" for other lines
+std::string getContigId(const std::string& headerLine);
+
+const std::string load(const std::string nameOfChromosome, std::ifstream& genomeFile, std::string& outputSequence,
+  const std::atomic<bool>* isCancelled = NULL);
+
+#endif // REFERENCE_H
@@ -0,0 +1,132 @@
+/**
+  reference_client.cpp
+
+  Purpose: sends requests to a running reference_server and prints its answers. The request can be
+  given on the command line; without one, every line of standard input is sent as a request. A QUIT
+  request closes the connection, so the client stops there.
+
+  Usage: ./reference_client socket_path [request]
+  Example: ./reference_client /tmp/hg38.sock SEQ chr1 1020 1040
+  Example: ./reference_client /tmp/hg38.sock < requests.txt
+
+  Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
+**/
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool sendLine(int socketDescriptor, const std::string& line) {
+  std::string message = line + "\n";
+  size_t bytesSent = 0;
+  while (bytesSent < message.length()) {
+    // MSG_NOSIGNAL: a server that has gone away should give an error message, not a SIGPIPE
+    ssize_t result = send(socketDescriptor, message.data() + bytesSent, message.length() - bytesSent, MSG_NOSIGNAL);
+    if (result <= 0) {
+      return false;
+    }
+    bytesSent += result;
+  }
+  return true;
+}
+
+/** Reads a single line (the answer to one request) from the socket. **/
+bool receiveLine(int socketDescriptor, std::string& pendingInput, std::string& line) {
+  char buffer[65536];
+  size_t lineEnd;
+  while ((lineEnd = pendingInput.find('\n')) == std::string::npos) {
+    ssize_t bytesReceived = recv(socketDescriptor, buffer, sizeof(buffer), 0);
+    if (bytesReceived <= 0) {
+      return false;
+    }
+    pendingInput.append(buffer, bytesReceived);
+  }
+  line = pendingInput.substr(0, lineEnd);
+  pendingInput.erase(0, lineEnd + 1);
+  return true;
+}
+
+/**
+ * Sends one request and prints the answer. Returns false if the client should stop: after QUIT, which
+ * the server does not answer, or if the connection was lost (which is then reported in 'isLost').
+ */
+bool sendRequest(int socketDescriptor, const std::string& request, std::string& pendingInput, bool& isLost) {
+  isLost = !sendLine(socketDescriptor, request);
+  if (isLost || request == "QUIT") {
+    return false;
+  }
+  std::string answer;
+  isLost = !receiveLine(socketDescriptor, pendingInput, answer);
+  if (isLost) {
+    return false;
+  }
+  std::cout << answer << "\n";
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cout <<
+      "reference_client\n"
+      "\n"
+      "Purpose: sends requests to a running reference_server and prints its answers. The request can be "
+      "given on the command line; without one, every line of standard input is sent as a request. A QUIT "
+      "request closes the connection, so the client stops there.\n"
+      "\n"
+      "Usage: ./reference_client socket_path [request]\n"
+      "Example: ./reference_client /tmp/hg38.sock SEQ chr1 1020 1040\n"
+      "Example: ./reference_client /tmp/hg38.sock < requests.txt\n"
+      "\n"
+      "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
+    return -1;
+  }
+  std::string socketPath = argv[1];
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.length() >= sizeof(address.sun_path)) {
+    std::cerr << "reference_client error: socket path " << socketPath << " is too long." << std::endl;
+    return -1;
+  }
+  strcpy(address.sun_path, socketPath.c_str());
+  int clientSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (clientSocket < 0 || connect(clientSocket, (sockaddr*)&address, sizeof(address)) != 0) {
+    std::cerr << "reference_client error: cannot connect to " << socketPath << std::endl;
+    return -1;
+  }
+
+  std::string pendingInput;
+  bool isLost = false;
+  bool hasQuit = false;
+  if (argc > 2) {
+    std::string request = argv[2];
+    for (int argumentIndex = 3; argumentIndex < argc; ++argumentIndex) {
+      request += std::string(" ") + argv[argumentIndex];
+    }
+    hasQuit = !sendRequest(clientSocket, request, pendingInput, isLost);
+  } else {
+    std::string request;
+    while (!hasQuit && getline(std::cin, request)) {
+      if (request.length() > 0 && request[request.length() - 1] == '\r') {
+        request.erase(request.length() - 1);
+      }
+      if (request.length() > 0) {
+        hasQuit = !sendRequest(clientSocket, request, pendingInput, isLost);
+      }
+    }
+  }
+  if (isLost) {
+    std::cerr << "reference_client error: lost the connection to the server." << std::endl;
+    return -1;
+  }
+  if (!hasQuit) {
+    sendLine(clientSocket, "QUIT");
+  }
+  close(clientSocket);
+  return 0;
+}
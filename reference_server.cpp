@@ -0,0 +1,187 @@
+/**
+  reference_server.cpp
+
+  Purpose: keeps a reference genome loaded (or mapped, for a 2bit file) and answers questions about it
+  over a Unix-domain socket, so tools and scripts that need many small lookups don't have to start a
+  new process (and reread the reference) for each of them. Each request is a single line, and gets a
+  single line as answer, starting with "OK" or "ERR":
+
+  SEQ chromosome start_pos end_pos          -> OK bases (1-based, including end_pos; at most 1 Mb)
+  ALIGN chromosome pos ref alt              -> OK chromosome pos ref alt (left-aligned if it is an indel)
+  QUIT                                      -> closes the connection
+
+  reference_client can be used to send requests from the command line or from a file.
+
+  Usage: ./reference_server reference socket_path
+  Example: ./reference_server hg38.2bit /tmp/hg38.sock
+
+  Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
+**/
+
+#include <cctype> // toupper
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "left_alignment.h"
+#include "reference.h"
+
+// the reference is shared by all connections; requests take microseconds, so they simply take turns
+std::mutex referenceMutex;
+
+// the longest region a SEQ request may ask for, so that no single request holds the reference for long
+// or makes the server allocate a large answer; longer regions can be requested in parts
+const int MAXIMUM_SEQUENCE_REQUEST_LENGTH = 1000000;
+
+std::string handleRequest(ReferenceGenome& referenceGenome, const std::string& request) {
+  std::stringstream ss;
+  ss << request;
+  std::string command;
+  ss >> command;
+  if (command == "SEQ") {
+    std::string chromosomeName;
+    int startPos = 0;
+    int endPos = 0;
+    if (!(ss >> chromosomeName >> startPos >> endPos) || startPos < 1 || endPos < startPos) {
+      return "ERR usage: SEQ chromosome start_pos end_pos";
+    }
+    if (endPos - startPos >= MAXIMUM_SEQUENCE_REQUEST_LENGTH) {
+      std::stringstream answer;
+      answer << "ERR regions of more than " << MAXIMUM_SEQUENCE_REQUEST_LENGTH << " bases must be requested in parts";
+      return answer.str();
+    }
+    std::lock_guard<std::mutex> lock(referenceMutex);
+    const ReferenceSequence& chromosome = referenceGenome.getChromosome(chromosomeName);
+    if (chromosome.length() == 0) {
+      return "ERR unknown chromosome " + chromosomeName;
+    }
+    return "OK " + chromosome.substr(startPos, endPos - startPos + 1);
+  } else if (command == "ALIGN") {
+    std::string chromosomeName;
+    int position = 0;
+    std::string referenceAllele;
+    std::string alternativeAllele;
+    if (!(ss >> chromosomeName >> position >> referenceAllele >> alternativeAllele)) {
+      return "ERR usage: ALIGN chromosome pos ref alt";
+    }
+    std::lock_guard<std::mutex> lock(referenceMutex);
+    const ReferenceSequence& chromosome = referenceGenome.getChromosome(chromosomeName);
+    if (chromosome.length() == 0) {
+      return "ERR unknown chromosome " + chromosomeName;
+    }
+    if (leftAlignIndel(chromosome, position, referenceAllele, alternativeAllele) == REFERENCE_MISMATCH) {
+      return "ERR reference sequence does not match the reference genome";
+    }
+    std::stringstream answer;
+    answer << "OK " << chromosomeName << "\t" << position << "\t" << referenceAllele << "\t" << alternativeAllele;
+    return answer.str();
+  } else {
+    return "ERR unknown command " + command;
+  }
+}
+
+bool sendLine(int socketDescriptor, const std::string& line) {
+  std::string message = line + "\n";
+  size_t bytesSent = 0;
+  while (bytesSent < message.length()) {
+    ssize_t result = send(socketDescriptor, message.data() + bytesSent, message.length() - bytesSent, 0);
+    if (result <= 0) {
+      return false;
+    }
+    bytesSent += result;
+  }
+  return true;
+}
+
+/** Answers the requests of one client until it closes the connection or sends QUIT. **/
+void serveConnection(ReferenceGenome* referenceGenome, int socketDescriptor) {
+  std::string pendingInput;
+  char buffer[65536];
+  bool isOpen = true;
+  while (isOpen) {
+    ssize_t bytesReceived = recv(socketDescriptor, buffer, sizeof(buffer), 0);
+    if (bytesReceived <= 0) {
+      break;
+    }
+    pendingInput.append(buffer, bytesReceived);
+    size_t lineStart = 0;
+    size_t lineEnd;
+    while (isOpen && (lineEnd = pendingInput.find('\n', lineStart)) != std::string::npos) {
+      std::string request = pendingInput.substr(lineStart, lineEnd - lineStart);
+      lineStart = lineEnd + 1;
+      if (request.length() > 0 && request[request.length() - 1] == '\r') {
+        request.erase(request.length() - 1);
+      }
+      if (request == "QUIT") {
+        isOpen = false;
+      } else if (request.length() > 0) {
+        isOpen = sendLine(socketDescriptor, handleRequest(*referenceGenome, request));
+      }
+    }
+    pendingInput.erase(0, lineStart);
+  }
+  close(socketDescriptor);
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cout <<
+      "reference_server\n"
+      "\n"
+      "Purpose: keeps a reference genome loaded (or mapped, for a 2bit file) and answers questions about it "
+      "over a Unix-domain socket, so tools and scripts that need many small lookups don't have to start a "
+      "new process (and reread the reference) for each of them. Each request is a single line, and gets a "
+      "single line as answer, starting with \"OK\" or \"ERR\":\n"
+      "\n"
+      "SEQ chromosome start_pos end_pos          -> OK bases (1-based, including end_pos; at most 1 Mb)\n"
+      "ALIGN chromosome pos ref alt              -> OK chromosome pos ref alt (left-aligned if it is an indel)\n"
+      "QUIT                                      -> closes the connection\n"
+      "\n"
+      "reference_client can be used to send requests from the command line or from a file.\n"
+      "\n"
+      "Usage: ./reference_server reference socket_path\n"
+      "Example: ./reference_server hg38.2bit /tmp/hg38.sock\n"
+      "\n"
+      "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
+    return -1;
+  }
+  std::string nameOfReference = argv[1];
+  std::string socketPath = argv[2];
+
+  ReferenceGenome referenceGenome(nameOfReference, true);
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.length() >= sizeof(address.sun_path)) {
+    std::cerr << "reference_server error: socket path " << socketPath << " is too long." << std::endl;
+    return -1;
+  }
+  strcpy(address.sun_path, socketPath.c_str());
+  int serverSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath.c_str());
+  if (serverSocket < 0 || bind(serverSocket, (sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(serverSocket, 64) != 0) {
+    std::cerr << "reference_server error: cannot listen on " << socketPath << std::endl;
+    return -1;
+  }
+  signal(SIGPIPE, SIG_IGN); // a client that disconnects early should not stop the server
+  std::cout << "Serving " << nameOfReference << " on " << socketPath << std::endl;
+
+  while (true) {
+    int clientSocket = accept(serverSocket, NULL, NULL);
+    if (clientSocket < 0) {
+      continue;
+    }
+    std::thread(serveConnection, &referenceGenome, clientSocket).detach();
+  }
+}
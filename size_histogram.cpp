@@ -0,0 +1,64 @@
+#include "size_histogram.h"
+
+SizeHistogram::SizeHistogram(int exactLimit) : exactLimit_(exactLimit < 1 ? 1 : exactLimit), total_(0) {
+}
+
+/**
+ * Bin i < exactLimit holds size i; bin exactLimit + k holds the sizes from exactLimit * 2^k
+ * to exactLimit * 2^(k+1) - 1.
+ */
+int SizeHistogram::getBinIndex(long long size) const {
+  if (size < exactLimit_) {
+    return (size < 0) ? 0 : static_cast<int>(size);
+  }
+  int binIndex = exactLimit_;
+  for (long long binEnd = 2LL * exactLimit_; size >= binEnd; binEnd *= 2) {
+    ++binIndex;
+  }
+  return binIndex;
+}
+
+void SizeHistogram::add(long long size, long long count) {
+  int binIndex = getBinIndex(size);
+  if (binIndex >= counts_.size()) {
+    counts_.resize(binIndex + 1, 0);
+  }
+  counts_[binIndex] += count;
+  total_ += count;
+}
+
+void SizeHistogram::merge(const SizeHistogram& otherHistogram) {
+  if (otherHistogram.counts_.size() > counts_.size()) {
+    counts_.resize(otherHistogram.counts_.size(), 0);
+  }
+  for (int binIndex = 0; binIndex < otherHistogram.counts_.size(); ++binIndex) {
+    counts_[binIndex] += otherHistogram.counts_[binIndex];
+  }
+  total_ += otherHistogram.total_;
+}
+
+long long SizeHistogram::getTotal() const {
+  return total_;
+}
+
+int SizeHistogram::getNumberOfBins() const {
+  return counts_.size();
+}
+
+long long SizeHistogram::getBinStart(int binIndex) const {
+  if (binIndex < exactLimit_) {
+    return binIndex;
+  }
+  return static_cast<long long>(exactLimit_) << (binIndex - exactLimit_);
+}
+
+long long SizeHistogram::getBinEnd(int binIndex) const {
+  if (binIndex < exactLimit_) {
+    return binIndex;
+  }
+  return (static_cast<long long>(exactLimit_) << (binIndex - exactLimit_ + 1)) - 1;
+}
+
+long long SizeHistogram::getBinCount(int binIndex) const {
+  return counts_[binIndex];
+}
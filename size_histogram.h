@@ -0,0 +1,35 @@
+#ifndef SIZE_HISTOGRAM_H
+#define SIZE_HISTOGRAM_H
+
+#include <vector>
+
+/**
+ * 'SizeHistogram' counts event sizes. Sizes below 'exactLimit' each have their
+ * own bin; larger sizes are counted in bins that double in width (exactLimit
+ * to 2*exactLimit - 1, and so on), so SVs of a megabase take a handful of bins
+ * instead of one per size. Histograms with the same exactLimit can be merged,
+ * so each thread can count its own part of a file.
+ */
+class SizeHistogram {
+public:
+  SizeHistogram(int exactLimit = 64);
+
+  void add(long long size, long long count = 1);
+  void merge(const SizeHistogram& otherHistogram);
+
+  long long getTotal() const;
+  int getNumberOfBins() const;
+  // the smallest and largest size of a bin, and the number of events in it
+  long long getBinStart(int binIndex) const;
+  long long getBinEnd(int binIndex) const;
+  long long getBinCount(int binIndex) const;
+
+private:
+  int getBinIndex(long long size) const;
+
+  int exactLimit_;
+  std::vector<long long> counts_;
+  long long total_;
+};
+
+#endif // SIZE_HISTOGRAM_H
@@ -0,0 +1,59 @@
+#include "symbolic_alleles.h"
+
+#include <cstdlib> // atoi, abs
+
+bool isSymbolicAllele(const std::string& allele) {
+  return (allele.length() > 2 && allele[0] == '<' && allele[allele.length() - 1] == '>');
+}
+
+std::string getSymbolicAlleleType(const std::string& allele) {
+  if (!isSymbolicAllele(allele)) {
+    return "";
+  }
+  size_t endOfType = allele.find(':');
+  if (endOfType == std::string::npos) {
+    endOfType = allele.length() - 1;
+  }
+  return allele.substr(1, endOfType - 1);
+}
+
+bool findInfoValue(const std::string& info, const std::string& key, std::string& value) {
+  size_t entryStart = 0;
+  while (entryStart < info.length()) {
+    size_t entryEnd = info.find(';', entryStart);
+    if (entryEnd == std::string::npos) {
+      entryEnd = info.length();
+    }
+    if (info.compare(entryStart, key.length(), key) == 0) {
+      size_t keyEnd = entryStart + key.length();
+      if (keyEnd == entryEnd) {
+        value = ""; // a flag
+        return true;
+      } else if (info[keyEnd] == '=') {
+        value = info.substr(keyEnd + 1, entryEnd - keyEnd - 1);
+        return true;
+      }
+    }
+    entryStart = entryEnd + 1;
+  }
+  return false;
+}
+
+int getSymbolicEventSize(const std::string& info, int position) {
+  std::string value;
+  if (findInfoValue(info, "SVLEN", value) && !value.empty()) {
+    return abs(atoi(value.c_str())); // deletions often have a negative SVLEN
+  }
+  // an insertion usually has END = POS, which says nothing about its size, so then SEQ is tried first
+  int endSize = -1;
+  if (findInfoValue(info, "END", value) && !value.empty()) {
+    endSize = abs(atoi(value.c_str()) - position);
+    if (endSize > 0) {
+      return endSize;
+    }
+  }
+  if (findInfoValue(info, "SEQ", value)) {
+    return value.length();
+  }
+  return endSize;
+}
@@ -0,0 +1,22 @@
+#ifndef SYMBOLIC_ALLELES_H
+#define SYMBOLIC_ALLELES_H
+
+#include <string>
+
+// whether the allele is symbolic ("<DEL>", "<INS:ME:ALU>", ...) instead of a sequence of bases
+bool isSymbolicAllele(const std::string& allele);
+
+// the main type of a symbolic allele, so "DEL" for "<DEL>" and "INS" for "<INS:ME:ALU>"
+std::string getSymbolicAlleleType(const std::string& allele);
+
+// finds the value of a key in an INFO field, like "-300" for SVLEN in "SVTYPE=DEL;SVLEN=-300";
+// returns false if the key is absent
+bool findInfoValue(const std::string& info, const std::string& key, std::string& value);
+
+// the size of an event with a symbolic allele, read from the INFO field instead of from the
+// alleles: |SVLEN| if given, otherwise END - POS, otherwise the length of SEQ (PacBio insertions).
+// An END equal to POS, as insertions have, only gives size 0 if there is no SEQ either. Returns -1 if
+// the size is unknown
+int getSymbolicEventSize(const std::string& info, int position);
+
+#endif // SYMBOLIC_ALLELES_H
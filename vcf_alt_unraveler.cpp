@@ -12,20 +12,35 @@
   higher factual correctness of the GATK calls, which in this regard could be considered
   superior to other SV callers, be it by complicating matters for VCF parsers)
  
-  Usage: ./unravel_alts input_vcf output_vcf
+  Each ALT allele that occurs in a genotype (or every ALT allele, if the file has no genotypes) gets
+  its own record, in which GTs are renumbered (keeping phasing) and the values of fields that have
+  one value per ALT allele, per allele or per genotype (Number=A, R or G in the header, like AC, AD
+  and PL) are reduced to those of the reference and that ALT allele.
+
+  With -j, the tool works the other way around: adjacent records (in a sorted file) with the same CHROM,
+  POS and REF are joined into one record with all their ALT alleles; GTs are renumbered, and Number=A
+  and R values are gathered from all records (Number=G values, which cannot be rebuilt, become '.').
+
+  Usage: ./unravel_alts input_vcf output_vcf [-j]
   Example: ./unravel_alts gatk_hanchild.vcf gatk_hanchild_unraveled.vcf
+  Example: ./unravel_alts gatk_hanchild_unraveled.vcf gatk_hanchild_joined.vcf -j
 
   Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
+#include <algorithm> // count, equal, find, sort
 #include <cstdlib>
+#include <cstring> // memchr
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <set>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "genotypes.h"
+
 /* Returns whether a string starts with a certain other string, so if
    'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
    returns true. */
@@ -65,101 +80,611 @@ std::vector<std::string> Split(const std::string& str, char separator) {
   return output;
 }
 
-std::set<int> getAllUsedAlts(const std::string& line) {
-  std::stringstream ss;
-  ss << line;
-  
-  // skip items before genotypes
-  for (int i = 0; i < 9; i++ ) {
-    std::string dummy;
-    ss >> dummy;
-//std::cout << "Dummy " << dummy << std::endl;
+/**
+ * 'FieldNumbers' holds, from the ##INFO and ##FORMAT header lines, the fields that have a value per
+ * ALT allele (Number=A), per allele (Number=R) or per genotype (Number=G), like AC, AD and PL; these
+ * values have to be split when a record is split.
+ */
+struct FieldNumbers {
+  std::map<std::string, char> infoNumbers_;
+  std::map<std::string, char> formatNumbers_;
+};
+
+/** The value of 'key' within a header line like ##INFO=<ID=AD,Number=R,...>; "" if absent **/
+std::string getHeaderValue(const std::string& headerLine, const std::string& key) {
+  size_t keyStart = headerLine.find(key + "=");
+  if (keyStart == std::string::npos) {
+    return "";
+  }
+  size_t valueStart = keyStart + key.length() + 1;
+  return headerLine.substr(valueStart, headerLine.find_first_of(",>", valueStart) - valueStart);
+}
+
+void readFieldNumber(const std::string& headerLine, FieldNumbers& fieldNumbers) {
+  bool isInfo = StringStartsWith(headerLine, "##INFO=<");
+  if (!isInfo && !StringStartsWith(headerLine, "##FORMAT=<")) {
+    return;
+  }
+  std::string number = getHeaderValue(headerLine, "Number");
+  if (number == "A" || number == "R" || number == "G") {
+    (isInfo ? fieldNumbers.infoNumbers_ : fieldNumbers.formatNumbers_)[getHeaderValue(headerLine, "ID")] = number[0];
+  }
+}
+
+/**
+ * Appends the values of a Number=A, R or G field (comma-separated, from 'start' to 'end') that belong to
+ * the record of ALT allele altId. With a diploid Number=G field (like PL), those are the values of 0/0,
+ * 0/altId and altId/altId. Values that do not have the expected count (like ".") are copied unchanged.
+ */
+void appendValuesOfAlt(const char* start, const char* end, char number, int altId, int numberOfAlts,
+    std::string& output) {
+  int numberOfValues = 1 + std::count(start, end, ',');
+  int numberOfAlleles = numberOfAlts + 1;
+  int selectedValues[3];
+  int numberOfSelected = 0;
+  if (number == 'A' && numberOfValues == numberOfAlts) {
+    selectedValues[numberOfSelected++] = altId - 1;
+  } else if ((number == 'R' || number == 'G') && numberOfValues == numberOfAlleles) {
+    // R, or a haploid G
+    selectedValues[numberOfSelected++] = 0;
+    selectedValues[numberOfSelected++] = altId;
+  } else if (number == 'G' && numberOfValues == numberOfAlleles * (numberOfAlleles + 1) / 2) {
+    // diploid genotype j/k (j <= k) comes at index k * (k + 1) / 2 + j
+    selectedValues[numberOfSelected++] = 0;
+    selectedValues[numberOfSelected++] = altId * (altId + 1) / 2;
+    selectedValues[numberOfSelected++] = altId * (altId + 1) / 2 + altId;
+  } else {
+    output.append(start, end);
+    return;
+  }
+  const char* valueStart = start;
+  int selectedIndex = 0;
+  for (int valueIndex = 0; selectedIndex < numberOfSelected; ++valueIndex) {
+    const char* valueEnd = std::find(valueStart, end, ',');
+    if (valueIndex == selectedValues[selectedIndex]) {
+      if (selectedIndex > 0) {
+        output += ',';
+      }
+      output.append(valueStart, valueEnd);
+      ++selectedIndex;
+    }
+    valueStart = valueEnd + 1;
   }
+}
 
+/** Appends the INFO field for the record of ALT allele altId, splitting the Number=A/R/G values **/
+void appendInfo(const char* start, const char* end, const FieldNumbers& fieldNumbers, int altId, int numberOfAlts,
+    std::string& output) {
+  const char* entryStart = start;
+  while (entryStart < end) {
+    const char* entryEnd = std::find(entryStart, end, ';');
+    const char* equalsSign = std::find(entryStart, entryEnd, '=');
+    std::map<std::string, char>::const_iterator numberIt = fieldNumbers.infoNumbers_.end();
+    if (equalsSign != entryEnd) {
+      numberIt = fieldNumbers.infoNumbers_.find(std::string(entryStart, equalsSign));
+    }
+    if (entryStart != start) {
+      output += ';';
+    }
+    if (numberIt == fieldNumbers.infoNumbers_.end()) {
+      output.append(entryStart, entryEnd);
+    } else {
+      output.append(entryStart, equalsSign + 1);
+      appendValuesOfAlt(equalsSign + 1, entryEnd, numberIt->second, altId, numberOfAlts, output);
+    }
+    entryStart = entryEnd + 1;
+  }
+}
+
+// how the subfields of a sample are rewritten: the GT, a Number=A/R/G field (its number), or unchanged
+const char GENOTYPE_SUBFIELD = 'T';
+const char UNCHANGED_SUBFIELD = ' ';
+
+/**
+ * 'MultiAltRecord' is a record with several ALT alleles, split into its fields once,
+ * so that the biallelic record of each ALT allele can be written straight into an
+ * output buffer.
+ */
+class MultiAltRecord {
+public:
+  MultiAltRecord(const std::string& line, const FieldNumbers& fieldNumbers);
+
+  int numberOfAlts() const;
+  std::set<int> getUsedAlts() const;
+  void appendBiallelicRecord(int altId, std::string& output) const;
+
+private:
+  const std::string& line_;
+  const FieldNumbers& fieldNumbers_;
+  const char* fieldStarts_[10]; // of CHROM to FORMAT and the first sample; beyond the end of the line if absent
+  std::vector<const char*> altStarts_; // and, at the end, the end of the ALT field (+1)
+  std::vector<char> subfieldTypes_; // per FORMAT key
+  PackedGenotypes genotypes_;
+};
+
+MultiAltRecord::MultiAltRecord(const std::string& line, const FieldNumbers& fieldNumbers) :
+    line_(line), fieldNumbers_(fieldNumbers) {
+  const char* end = line.data() + line.length();
+  fieldStarts_[0] = line.data();
+  for (int fieldIndex = 1; fieldIndex < 10; ++fieldIndex) {
+    const char* previousStart = fieldStarts_[fieldIndex - 1];
+    fieldStarts_[fieldIndex] = (previousStart > end) ? previousStart : std::find(previousStart, end, '\t') + 1;
+  }
+  if (fieldStarts_[5] > end) {
+    std::cerr << "unravel_alts error: the line '" << line << "' is not a valid VCF record." << std::endl;
+    exit(-1);
+  }
+  for (const char* altStart = fieldStarts_[4]; altStart < fieldStarts_[5];
+      altStart = std::find(altStart, fieldStarts_[5] - 1, ',') + 1) {
+    altStarts_.push_back(altStart);
+  }
+  altStarts_.push_back(fieldStarts_[5]);
+
+  // the GT must be the first subfield, as the VCF specification requires
+  const char* format = fieldStarts_[8];
+  bool hasGenotypes = (fieldStarts_[9] <= end && format[0] == 'G' && format[1] == 'T' &&
+    (format[2] == ':' || format[2] == '\t'));
+  for (const char* key = format; hasGenotypes && key < fieldStarts_[9]; ) {
+    const char* keyEnd = std::find(key, fieldStarts_[9] - 1, ':');
+    std::string name(key, keyEnd);
+    std::map<std::string, char>::const_iterator numberIt = fieldNumbers.formatNumbers_.find(name);
+    if (name == "GT") {
+      subfieldTypes_.push_back(GENOTYPE_SUBFIELD);
+    } else {
+      subfieldTypes_.push_back((numberIt == fieldNumbers.formatNumbers_.end()) ? UNCHANGED_SUBFIELD : numberIt->second);
+    }
+    key = keyEnd + 1;
+  }
+  genotypes_.parse(hasGenotypes ? fieldStarts_[9] : end, end);
+}
+
+int MultiAltRecord::numberOfAlts() const {
+  return altStarts_.size() - 1;
+}
+
+/** The ALT alleles that occur in a genotype; all of them if the record has no genotypes **/
+std::set<int> MultiAltRecord::getUsedAlts() const {
+  if (genotypes_.numberOfSamples() > 0) {
+    return genotypes_.getUsedAlternativeAlleles();
+  }
   std::set<int> usedAlts;
+  for (int altId = 1; altId <= numberOfAlts(); ++altId) {
+    usedAlts.insert(altId);
+  }
+  return usedAlts;
+}
 
-  while (ss) {
-    std::string genotype;
-    ss >> genotype;
-    if (genotype == "") {
-      // end of stream
-      break;
+/**
+ * Appends the record for one ALT allele (and a newline): the ALT becomes that allele, in every GT the
+ * allele altId becomes 1 and the other ALT alleles become 0 (keeping phasing), and the Number=A/R/G
+ * values of INFO and of the samples are reduced to those of the reference and this ALT allele.
+ */
+void MultiAltRecord::appendBiallelicRecord(int altId, std::string& output) const {
+  const char* end = line_.data() + line_.length();
+  output.append(fieldStarts_[0], fieldStarts_[4]);
+  output.append(altStarts_[altId - 1], altStarts_[altId] - 1); // !important (of course) to replace the alt
+  output += '\t';
+  if (fieldStarts_[7] > end) {
+    output.append(fieldStarts_[5], end); // no INFO
+    output += '\n';
+    return;
+  }
+  output.append(fieldStarts_[5], fieldStarts_[7]); // QUAL and FILTER
+  appendInfo(fieldStarts_[7], fieldStarts_[8] - 1, fieldNumbers_, altId, numberOfAlts(), output);
+  if (fieldStarts_[8] <= end) {
+    output += '\t';
+    output.append(fieldStarts_[8], fieldStarts_[9] - 1); // FORMAT
+  }
+  if (subfieldTypes_.empty()) {
+    if (fieldStarts_[9] <= end) {
+      output += '\t';
+      output.append(fieldStarts_[9], end);
     }
-//std::cout << "GT " << genotype << std::endl;
-    int colonPos = genotype.find_first_of(':');
-    if ( colonPos != std::string::npos ) {
-      genotype = genotype.substr(0,colonPos);
+    output += '\n';
+    return;
+  }
+
+  std::vector<int> alleleMap(altId + 1, 0);
+  alleleMap[altId] = 1;
+  const char* sampleStart = fieldStarts_[9];
+  for (int sampleIndex = 0; sampleIndex < genotypes_.numberOfSamples(); ++sampleIndex) {
+    const char* sampleEnd = static_cast<const char*>(memchr(sampleStart, '\t', end - sampleStart));
+    if (sampleEnd == NULL) {
+      sampleEnd = end;
     }
-//std::cout << "GT2 " << genotype << std::endl;
-    std::vector<std::string> genotypeAsStrings = Split(genotype,'/');
-    for (int i = 0; i < genotypeAsStrings.size(); ++i ) {
-//std::cout << "GT3 " << genotype << std::endl;
-      if (genotypeAsStrings[i] != "." && genotypeAsStrings[i] != "0") {
-         usedAlts.insert( atoi(genotypeAsStrings[i].c_str()));
+    output += '\t';
+    const char* subfieldStart = sampleStart;
+    for (int subfieldIndex = 0; subfieldStart <= sampleEnd; ++subfieldIndex) {
+      const char* subfieldEnd = std::find(subfieldStart, sampleEnd, ':');
+      if (subfieldIndex > 0) {
+        output += ':';
       }
+      char subfieldType = (subfieldIndex < subfieldTypes_.size()) ? subfieldTypes_[subfieldIndex] : UNCHANGED_SUBFIELD;
+      if (subfieldType == GENOTYPE_SUBFIELD) {
+        genotypes_.appendGenotype(sampleIndex, output, &alleleMap);
+      } else if (subfieldType == UNCHANGED_SUBFIELD) {
+        output.append(subfieldStart, subfieldEnd);
+      } else {
+        appendValuesOfAlt(subfieldStart, subfieldEnd, subfieldType, altId, numberOfAlts(), output);
+      }
+      subfieldStart = subfieldEnd + 1;
     }
+    sampleStart = sampleEnd + 1;
   }
-//std::cout << "GT4 " << std::endl;
-  return usedAlts;
+  output += '\n';
 }
 
-std::string altify(const std::string& line, int altId, const std::string& correctAlt) {
-  std::stringstream ss;
-  std::stringstream outSs;
-  ss << line;
-  for (int i = 0; i < 4; i++ ) {
-    // just output chrom, pos, id and ref normally
-    std::string item;
-    ss >> item;
-    outSs << item << "\t";
-  }
-  std::string officialAlt;
-  ss >> officialAlt;
-  outSs << correctAlt << "\t"; // !important (of course) to replace the alt
-  for (int i = 0; i < 4; i++ ) {
-    // just output qual filter, infor and format normally
-    std::string item;
-    ss >> item;
-    outSs << item << "\t";
-  }
-  while (ss) {
-    // loop over the genotypes
-    std::string genotype;
-    ss >> genotype;
-    int position;
-    for (position = 0; position < genotype.length(); ++position) {
-      // assumption: less than 9 alt alleles...
-      char ch = genotype[position];
-      if (ch == ':') {
-         outSs << ch;
-         break;
-      }
-      if (ch == altId + '0') {
-        ch = '1';
-      } else if (ch >= '0' && ch <= '9') {
-        ch = '0';
-      }
-      outSs << ch;
-    }
-    ++position;
-    while (position < genotype.length()) {
-      outSs << genotype[position];
-      ++position;
-    } 
-    if (ss) {
-      outSs << '\t';
-    }
-  }
-  return outSs.str();
+/** A part of a line, like a field or a subfield, that is not copied **/
+struct TextRange {
+  const char* start_;
+  const char* end_;
+};
+
+std::vector<TextRange> splitRange(TextRange range, char separator) {
+  std::vector<TextRange> parts;
+  const char* partStart = range.start_;
+  while (true) {
+    const char* partEnd = std::find(partStart, range.end_, separator);
+    TextRange part = { partStart, partEnd };
+    parts.push_back(part);
+    if (partEnd == range.end_) {
+      return parts;
+    }
+    partStart = partEnd + 1;
+  }
+}
+
+bool rangeEquals(TextRange range, const std::string& text) {
+  return text.compare(0, std::string::npos, range.start_, range.end_ - range.start_) == 0;
+}
+
+bool rangesEqual(TextRange leftRange, TextRange rightRange) {
+  return (leftRange.end_ - leftRange.start_ == rightRange.end_ - rightRange.start_) &&
+    std::equal(leftRange.start_, leftRange.end_, rightRange.start_);
+}
+
+/** Finds the value of key in an INFO field ("DP=5;AC=1,2"), or of the subfield named key in a sample **/
+bool findValue(const std::vector<TextRange>& entries, const std::string& key, TextRange& value) {
+  for (int entryIndex = 0; entryIndex < entries.size(); ++entryIndex) {
+    const char* equalsSign = std::find(entries[entryIndex].start_, entries[entryIndex].end_, '=');
+    TextRange entryKey = { entries[entryIndex].start_, equalsSign };
+    if (equalsSign != entries[entryIndex].end_ && rangeEquals(entryKey, key)) {
+      value.start_ = equalsSign + 1;
+      value.end_ = entries[entryIndex].end_;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * 'JoinableRecord' is one of the records at the same CHROM, POS and REF that are joined
+ * into one multi-ALT record: its fields, and where its ALT alleles go in the joined record.
+ */
+struct JoinableRecord {
+  std::vector<TextRange> fields_;
+  std::vector<TextRange> alts_;
+  std::vector<int> alleleMap_; // for each allele of the record (0 is REF), its number in the joined record
+  std::vector<TextRange> formatKeys_;
+  PackedGenotypes genotypes_;
+};
+
+void parseJoinableRecord(const std::string& line, JoinableRecord& record) {
+  TextRange wholeLine = { line.data(), line.data() + line.length() };
+  record.fields_ = splitRange(wholeLine, '\t');
+  if (record.fields_.size() < 5) {
+    std::cerr << "unravel_alts error: the line '" << line << "' is not a valid VCF record." << std::endl;
+    exit(-1);
+  }
+  record.alts_ = splitRange(record.fields_[4], ',');
+  record.formatKeys_.clear();
+  if (record.fields_.size() > 8) {
+    record.formatKeys_ = splitRange(record.fields_[8], ':');
+  }
+  bool hasGenotypes = (record.fields_.size() > 9 && rangeEquals(record.formatKeys_[0], "GT"));
+  record.genotypes_.parse(hasGenotypes ? record.fields_[9].start_ : wholeLine.end_, wholeLine.end_);
+}
+
+/**
+ * Appends the values of a Number=A or R field in the joined record: each record's value for each of its
+ * ALT alleles goes to the place of that allele in the joined record, REF (R) comes from the first record
+ * that has one, and values that are missing, or that a record has in an unexpected count, become '.'.
+ */
+void appendJoinedValues(const std::vector<JoinableRecord>& records, const std::vector<TextRange>& values,
+    const std::vector<bool>& hasValues, char number, int numberOfJoinedAlts, std::string& output) {
+  int firstIndex = (number == 'A') ? 1 : 0;
+  std::vector<TextRange> joinedValues(numberOfJoinedAlts + 1 - firstIndex);
+  std::vector<bool> isFilled(joinedValues.size(), false);
+  for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+    if (!hasValues[recordIndex]) {
+      continue;
+    }
+    const JoinableRecord& record = records[recordIndex];
+    std::vector<TextRange> recordValues = splitRange(values[recordIndex], ',');
+    if (recordValues.size() != record.alts_.size() + 1 - firstIndex) {
+      continue;
+    }
+    for (int allele = firstIndex; allele <= record.alts_.size(); ++allele) {
+      int joinedIndex = record.alleleMap_[allele] - firstIndex;
+      if (!isFilled[joinedIndex]) {
+        joinedValues[joinedIndex] = recordValues[allele - firstIndex];
+        isFilled[joinedIndex] = true;
+      }
+    }
+  }
+  if (std::find(isFilled.begin(), isFilled.end(), true) == isFilled.end()) {
+    output += '.';
+    return;
+  }
+  for (int valueIndex = 0; valueIndex < joinedValues.size(); ++valueIndex) {
+    if (valueIndex > 0) {
+      output += ',';
+    }
+    if (isFilled[valueIndex]) {
+      output.append(joinedValues[valueIndex].start_, joinedValues[valueIndex].end_);
+    } else {
+      output += '.';
+    }
+  }
+}
+
+/**
+ * Appends the joined GT of a sample: it starts as the first record's call, and each ALT allele a record
+ * calls is put in the same place, or, if that place already holds another ALT allele, in a place that
+ * holds REF, so 0/1 (C) and 0/1 (G) become 1/2. Calls that are missing in every record stay missing, and
+ * unphased genotypes are written in ascending order.
+ */
+void appendJoinedGenotype(const std::vector<JoinableRecord>& records, int sampleIndex, std::string& output) {
+  const PackedGenotypes& firstGenotypes = records[0].genotypes_;
+  std::vector<int> alleles;
+  int numberOfCalls = (sampleIndex < firstGenotypes.numberOfSamples()) ? firstGenotypes.countCalls(sampleIndex) : 0;
+  for (int slot = 0; slot < numberOfCalls; ++slot) {
+    alleles.push_back(firstGenotypes.getAllele(sampleIndex, slot));
+  }
+  for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+    const JoinableRecord& record = records[recordIndex];
+    if (sampleIndex >= record.genotypes_.numberOfSamples()) {
+      continue;
+    }
+    for (int slot = 0; slot < record.genotypes_.ploidy() && slot < alleles.size(); ++slot) {
+      int allele = record.genotypes_.getAllele(sampleIndex, slot);
+      if (allele < 0 || allele > record.alts_.size()) {
+        continue;
+      }
+      int joinedAllele = record.alleleMap_[allele];
+      if (recordIndex == 0 || joinedAllele == 0) {
+        if (alleles[slot] < 0) {
+          alleles[slot] = joinedAllele;
+        }
+        continue;
+      }
+      int freeSlot = slot;
+      if (alleles[slot] > 0 && alleles[slot] != joinedAllele) {
+        freeSlot = std::find(alleles.begin(), alleles.end(), 0) - alleles.begin();
+      }
+      if (freeSlot < alleles.size()) {
+        alleles[freeSlot] = joinedAllele;
+      }
+    }
+  }
+  bool isPhased = false;
+  for (int slot = 1; slot < alleles.size(); ++slot) {
+    isPhased = isPhased || firstGenotypes.isPhased(sampleIndex, slot);
+  }
+  if (!isPhased) {
+    std::sort(alleles.begin(), alleles.end()); // unphased genotypes are written in order, like 1/2
+  }
+  for (int slot = 0; slot < alleles.size(); ++slot) {
+    if (slot > 0) {
+      output += firstGenotypes.isPhased(sampleIndex, slot) ? '|' : '/';
+    }
+    if (alleles[slot] < 0) {
+      output += '.';
+    } else {
+      std::ostringstream number;
+      number << alleles[slot];
+      output += number.str();
+    }
+  }
+}
+
+/**
+ * Joins records with the same CHROM, POS and REF into one record with all their (different) ALT alleles,
+ * the inverse of unravelling. CHROM to REF, QUAL, FILTER, FORMAT and the fields that are not per allele
+ * come from the first record; GTs are renumbered, and Number=A/R values are gathered from all records.
+ * Number=G values cannot be rebuilt from biallelic records, so they become '.'.
+ */
+void appendJoinedRecord(const std::vector<std::string>& lines, const FieldNumbers& fieldNumbers,
+    std::vector<JoinableRecord>& records, std::string& output) {
+  if (lines.size() == 1) {
+    output += lines[0];
+    output += '\n';
+    return;
+  }
+  records.resize(lines.size());
+  std::vector<TextRange> joinedAlts;
+  for (int recordIndex = 0; recordIndex < lines.size(); ++recordIndex) {
+    JoinableRecord& record = records[recordIndex];
+    parseJoinableRecord(lines[recordIndex], record);
+    record.alleleMap_.assign(1, 0);
+    for (int altIndex = 0; altIndex < record.alts_.size(); ++altIndex) {
+      int joinedIndex = 0;
+      while (joinedIndex < joinedAlts.size() && !rangesEqual(joinedAlts[joinedIndex], record.alts_[altIndex])) {
+        ++joinedIndex;
+      }
+      if (joinedIndex == joinedAlts.size()) {
+        joinedAlts.push_back(record.alts_[altIndex]);
+      }
+      record.alleleMap_.push_back(joinedIndex + 1);
+    }
+  }
+  const JoinableRecord& first = records[0];
+  int numberOfJoinedAlts = joinedAlts.size();
+
+  output.append(lines[0].data(), first.fields_[4].start_); // CHROM, POS, ID and REF
+  for (int altIndex = 0; altIndex < numberOfJoinedAlts; ++altIndex) {
+    if (altIndex > 0) {
+      output += ',';
+    }
+    output.append(joinedAlts[altIndex].start_, joinedAlts[altIndex].end_);
+  }
+  if (first.fields_.size() < 8) {
+    output.append(first.fields_[4].end_, lines[0].data() + lines[0].length()); // QUAL and FILTER, if any
+    output += '\n';
+    return;
+  }
+  output.append(first.fields_[4].end_, first.fields_[7].start_); // QUAL and FILTER
+
+  std::vector<std::vector<TextRange> > infoEntries(records.size());
+  for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+    if (records[recordIndex].fields_.size() > 7) {
+      infoEntries[recordIndex] = splitRange(records[recordIndex].fields_[7], ';');
+    }
+  }
+  std::vector<TextRange> values(records.size());
+  std::vector<bool> hasValues(records.size());
+  for (int entryIndex = 0; entryIndex < infoEntries[0].size(); ++entryIndex) {
+    const TextRange& entry = infoEntries[0][entryIndex];
+    const char* equalsSign = std::find(entry.start_, entry.end_, '=');
+    std::string key(entry.start_, equalsSign);
+    std::map<std::string, char>::const_iterator numberIt = fieldNumbers.infoNumbers_.find(key);
+    if (entryIndex > 0) {
+      output += ';';
+    }
+    if (equalsSign == entry.end_ || numberIt == fieldNumbers.infoNumbers_.end()) {
+      output.append(entry.start_, entry.end_);
+    } else if (numberIt->second == 'G') {
+      output += key + "=.";
+    } else {
+      for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+        hasValues[recordIndex] = findValue(infoEntries[recordIndex], key, values[recordIndex]);
+      }
+      output += key + "=";
+      appendJoinedValues(records, values, hasValues, numberIt->second, numberOfJoinedAlts, output);
+    }
+  }
+  if (first.fields_.size() < 9) {
+    output += '\n';
+    return;
+  }
+  output += '\t';
+  output.append(first.fields_[8].start_, first.fields_[8].end_);
+
+  // for each FORMAT key of the first record, where the other records have it
+  int numberOfKeys = first.formatKeys_.size();
+  std::vector<std::vector<int> > keyIndices(records.size(), std::vector<int>(numberOfKeys, -1));
+  for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+    for (int keyIndex = 0; keyIndex < numberOfKeys; ++keyIndex) {
+      for (int otherIndex = 0; otherIndex < records[recordIndex].formatKeys_.size(); ++otherIndex) {
+        if (rangesEqual(records[recordIndex].formatKeys_[otherIndex], first.formatKeys_[keyIndex])) {
+          keyIndices[recordIndex][keyIndex] = otherIndex;
+        }
+      }
+    }
+  }
+  std::vector<char> keyNumbers(numberOfKeys, UNCHANGED_SUBFIELD);
+  for (int keyIndex = 0; keyIndex < numberOfKeys; ++keyIndex) {
+    std::string key(first.formatKeys_[keyIndex].start_, first.formatKeys_[keyIndex].end_);
+    std::map<std::string, char>::const_iterator numberIt = fieldNumbers.formatNumbers_.find(key);
+    if (key == "GT") {
+      keyNumbers[keyIndex] = GENOTYPE_SUBFIELD;
+    } else if (numberIt != fieldNumbers.formatNumbers_.end()) {
+      keyNumbers[keyIndex] = numberIt->second;
+    }
+  }
+
+  std::vector<std::vector<TextRange> > subfields(records.size());
+  for (int sampleIndex = 0; sampleIndex + 9 < first.fields_.size(); ++sampleIndex) {
+    for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+      subfields[recordIndex].clear();
+      if (sampleIndex + 9 < records[recordIndex].fields_.size()) {
+        subfields[recordIndex] = splitRange(records[recordIndex].fields_[sampleIndex + 9], ':');
+      }
+    }
+    output += '\t';
+    for (int keyIndex = 0; keyIndex < numberOfKeys && keyIndex < subfields[0].size(); ++keyIndex) {
+      if (keyIndex > 0) {
+        output += ':';
+      }
+      char number = keyNumbers[keyIndex];
+      if (number == GENOTYPE_SUBFIELD) {
+        appendJoinedGenotype(records, sampleIndex, output);
+      } else if (number == 'A' || number == 'R') {
+        for (int recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+          int subfieldIndex = keyIndices[recordIndex][keyIndex];
+          hasValues[recordIndex] = (subfieldIndex >= 0 && subfieldIndex < subfields[recordIndex].size());
+          if (hasValues[recordIndex]) {
+            values[recordIndex] = subfields[recordIndex][subfieldIndex];
+          }
+        }
+        appendJoinedValues(records, values, hasValues, number, numberOfJoinedAlts, output);
+      } else if (number == 'G') {
+        output += '.';
+      } else {
+        output.append(subfields[0][keyIndex].start_, subfields[0][keyIndex].end_);
+      }
+    }
+  }
+  output += '\n';
+}
+
+/** The CHROM, POS and REF of a record, which records that are joined share **/
+std::string getJoinKey(const std::string& line) {
+  size_t posEnd = line.find('\t', line.find('\t') + 1);
+  size_t refStart = line.find('\t', posEnd + 1) + 1;
+  size_t refEnd = line.find('\t', refStart);
+  return line.substr(0, posEnd) + line.substr(refStart - 1, refEnd - refStart + 1);
+}
+
+/**
+ * Join mode: reads a sorted VCF file and joins each run of adjacent records with the same CHROM, POS and
+ * REF into one multi-ALT record. Only the current run is held in memory.
+ */
+void joinFile(const std::string& nameOfInputFile, const std::string& nameOfOutputFile) {
+  std::ifstream inputFile(nameOfInputFile.c_str());
+  std::ofstream outputFile(nameOfOutputFile.c_str());
+  FieldNumbers fieldNumbers;
+  std::string line;
+  std::vector<std::string> group;
+  std::string keyOfGroup;
+  std::vector<JoinableRecord> records; // reused for every group
+  std::string outputBuffer;
+
+  while (true) {
+    bool hasLine = !getline(inputFile, line).fail() && line.length() > 0;
+    bool isHeader = hasLine && line[0] == '#';
+    std::string key = (hasLine && !isHeader) ? getJoinKey(line) : "";
+    if (!group.empty() && (!hasLine || isHeader || key != keyOfGroup)) {
+      outputBuffer.clear();
+      appendJoinedRecord(group, fieldNumbers, records, outputBuffer);
+      outputFile << outputBuffer;
+      group.clear();
+    }
+    if (!hasLine) {
+      break;
+    }
+    if (isHeader) {
+      readFieldNumber(line, fieldNumbers);
+      outputFile << line << "\n";
+      continue;
+    }
+    if (group.empty()) {
+      keyOfGroup = key;
+    }
+    group.push_back(line);
+  }
+  inputFile.close();
+  outputFile.close();
 }
 
 void transformFile(const std::string& nameOfInputFile, const std::string& nameOfOutputFile) {
   std::ifstream inputFile(nameOfInputFile.c_str());
   std::ofstream outputFile(nameOfOutputFile.c_str());
+  FieldNumbers fieldNumbers;
+  std::string line;
+  std::string outputBuffer; // reused for every record, so splitting does not allocate once it has grown
 
   while (!inputFile.eof()) {
-    std::string line;
-    std::stringstream buffer_ss;
     getline(inputFile, line );
     if (line.length() == 0) {
       break;
@@ -168,35 +693,32 @@ void transformFile(const std::string& nameOfInputFile, const std::string& nameOf
     // skip lines beginning with '#'
     const char START_OF_COMMENT_CHAR = '#';
     if (line[0] == START_OF_COMMENT_CHAR ) {
+      readFieldNumber(line, fieldNumbers);
       outputFile << line << "\n";
       continue;
     }
 
-    buffer_ss << line;
-    std::string dummy;
-    
-    for (int i = 0; i < 4; i++ ) {
-       buffer_ss >> dummy;
-    }
-
-    std::string alt;
-    buffer_ss >> alt;
-
-    if (alt.find_first_of(',') != std::string::npos) {
-      std::cout << "Alt " << alt << "\n";
-      std::vector<std::string> alts = Split(alt,',');
-      std::set<int> usedAltIds = getAllUsedAlts(line);
-//std::cout << "X";
+    size_t altStart = line.find('\t', line.find('\t', line.find('\t', line.find('\t') + 1) + 1) + 1) + 1;
+    size_t altEnd = line.find('\t', altStart);
+    size_t firstComma = line.find(',', altStart);
+    if (firstComma != std::string::npos && firstComma < altEnd) {
+      std::cout << "Alt " << line.substr(altStart, altEnd - altStart) << "\n";
+      MultiAltRecord record(line, fieldNumbers);
+      std::set<int> usedAltIds = record.getUsedAlts();
+      outputBuffer.clear();
       for (std::set<int>::iterator usedAltIdIt = usedAltIds.begin(); usedAltIdIt != usedAltIds.end(); ++usedAltIdIt) {
-         int altId = *usedAltIdIt;
-         std::string correctAlt = alts[altId - 1]; // in 0/1, 1 refers to the first alt, so A T,C would be T, which is the 0th element of alts
-         outputFile << altify(line, altId, correctAlt) << std::endl;
-         //std::cout << altify(line, altId, correctAlt) << std::endl;
+        int altId = *usedAltIdIt; // in 0/1, 1 refers to the first alt, so A T,C would be T
+        if (altId > record.numberOfAlts()) {
+          std::cout << "Genotype refers to ALT allele " << altId << ", which does not exist: " << line << "\n";
+          continue;
+        }
+        record.appendBiallelicRecord(altId, outputBuffer);
       }
+      outputFile << outputBuffer;
     } else {
       outputFile << line << "\n";
     }
-  }     
+  }
   inputFile.close();
   outputFile.close();
 }
@@ -217,9 +739,17 @@ int main(int argc, char** argv) {
       "this may be a better option for downstream compatibility (though it sacrifices the "
       "higher factual correctness of the GATK calls, which in this regard could be considered "
       "superior to many other SV callers, be it by complicating matters for VCF parsers).\n"
+      "Each ALT allele that occurs in a genotype (or every ALT allele, if the file has no genotypes) gets "
+      "its own record, in which GTs are renumbered (keeping phasing) and the values of fields that have "
+      "one value per ALT allele, per allele or per genotype (Number=A, R or G in the header, like AC, AD "
+      "and PL) are reduced to those of the reference and that ALT allele.\n"
+      "With -j, the tool works the other way around: adjacent records (in a sorted file) with the same CHROM, "
+      "POS and REF are joined into one record with all their ALT alleles; GTs are renumbered, and Number=A "
+      "and R values are gathered from all records (Number=G values, which cannot be rebuilt, become '.').\n"
       "\n"
-      "Usage: ./unravel_alts input_vcf output_vcf\n"
+      "Usage: ./unravel_alts input_vcf output_vcf [-j]\n"
       "Example: ./unravel_alts gatk_hanchild.vcf gatk_hanchild_unraveled.vcf\n"
+      "Example: ./unravel_alts gatk_hanchild_unraveled.vcf gatk_hanchild_joined.vcf -j\n"
       "\n"
       "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
     return -1;
@@ -232,7 +762,16 @@ int main(int argc, char** argv) {
   } else {
     std::string nameOfInputFile = argv[1];
     std::string nameOfOutputFile = argv[2];
-    transformFile(nameOfInputFile, nameOfOutputFile);   	
+    bool joinAlts = (argc > 3 && std::string(argv[3]) == "-j");
+    if (argc > 3 && !joinAlts) {
+      std::cout << "unravel_alts error: unknown option " << argv[3] << std::endl;
+      return -1;
+    }
+    if (joinAlts) {
+      joinFile(nameOfInputFile, nameOfOutputFile);
+    } else {
+      transformFile(nameOfInputFile, nameOfOutputFile);
+    }
     return 0;
   }
 }
@@ -5,23 +5,50 @@
   (similar location, same or similar SV-length) in the second file. Additional arguments
   indicate what difference in location is considered similar enough (or rather: which is
   the minimum distance at which events are considered dissimilar), and whether one should
-  ignore SV lengths in the comparison ('same_len' or 'ignore_len') 
-
-  Usage: ./compare first_vcf second_vcf wiggle_room_bp whether_compare_lengths merged_vcf
+  ignore SV lengths in the comparison ('same_len' or 'ignore_len'). Events with a symbolic allele
+  (<DEL>, <INS>) are compared by their SVLEN (or END), so "T <DEL>" with SVLEN=-3 matches "TACG T".
+  With '-r fraction', deletions are instead matched by reciprocal overlap: a deletion is found if
+  a deletion in the second file overlaps at least that fraction of both deletions.
+  With '-s fraction', insertions only match if their inserted sequences are at least that similar
+  (1 - edit distance / length of the longer sequence).
+  With '-h reference', events are instead matched by haplotype replay: events of both files that lie
+  within wiggle_room_bp of each other form a cluster, and an event is found if, together with other
+  events of its cluster, it changes the reference into the same sequence as some events of the second
+  file do. So "ACG A" matches "AC A" plus "G T" nearby, and shifted repeat indels match each other.
+  Events whose replay finds no match, and events that cannot be replayed (symbolic alleles, several
+  ALT alleles, REF not matching the reference), are compared the usual way, so -h only adds matches.
+  '-t threads' replays the clusters with several threads.
+  With '-g matrix_file', the genotypes (GT) of each found event and the event it matched are compared,
+  and for every sample a confusion matrix of 0/0, 0/1, 1/1 and ./. is written to matrix_file. Samples are
+  paired by name, or by column if the files have no sample names in common. (-g cannot be combined with -h,
+  as replayed events have no single partner.)
+
+  Usage: ./compare first_vcf second_vcf wiggle_room_bp whether_compare_lengths merged_vcf [-r fraction] [-s fraction] [-h reference [-t threads]] [-g matrix_file]
   Example: ./compare pacbio_deletions.vcf freebayes_deletions.vcf 10 same_len pacbio_del_found_by_freebayes.vcf
+  Example: ./compare pacbio_deletions.vcf manta_deletions.vcf 10 ignore_len pacbio_del_found_by_manta.vcf -r 0.5
+  Example: ./compare pacbio_insertions.vcf ont_insertions.vcf 50 ignore_len pacbio_ins_found_by_ont.vcf -s 0.8
+  Example: ./compare calls.vcf truth.vcf 50 ignore_len calls_in_truth.vcf -h hg38.2bit -t 8
+  Example: ./compare calls.vcf truth.vcf 10 same_len calls_in_truth.vcf -g genotype_concordance.txt
 
   Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
 #include <algorithm>
+#include <cctype> // isdigit
 #include <cstdlib>
+#include <cstring> // strchr
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "edit_distance.h"
+#include "event_type.h"
+#include "haplotype_comparison.h"
 #include "shared_functions.h"
+#include "symbolic_alleles.h"
 
 enum EventType { INS, DEL, SNP, RPL };
 
@@ -33,14 +60,6 @@ bool isDeletion(const std::string& ref, const std::string& alt) {
   return ((ref.length() > 1) && (alt.length() == 1 ));
 }
 
-bool isPureInsertion(const std::string& ref, const std::string& alt) {
-  return (isInsertion(ref,alt) && ref[0] == alt[0]);
-}
-
-bool isPureDeletion(const std::string& ref, const std::string& alt) {
-  return (isDeletion(ref,alt) && ref[0] == alt[0]);
-}
-
 class Coordinate {
 
 friend bool operator<(const Coordinate& leftCoordinate, const Coordinate& rightCoordinate);
@@ -138,18 +157,40 @@ class Event {
 
 public:
   Event(const std::string& line);
+  Event(const std::string& line, long long lineOffset);
   Event(const Coordinate& coordinate, const std::string& ref, const std::string& alt);
   Coordinate getCoordinate() const;
   EventType getType() const;
   int getSize() const;
+  const std::string& getInsertedSequence() const;
+  long long getLineOffset() const;
 
 private:
   Coordinate m_coordinate;
   std::string m_ref;
   std::string m_alt;
+  int m_symbolicSize; // for events with a symbolic allele, from SVLEN or END; -1 if unknown
+  std::string m_insertedSequence; // for insertions: the inserted bases (from SEQ for <INS>), if known
+  long long m_lineOffset; // where the line starts in its file, so its genotypes can be read back; -1 if unknown
 };
 
-Event::Event(const std::string& line) {
+/** Where the FORMAT column of a VCF line starts; npos if the line has no FORMAT column **/
+size_t findFormatColumn(const std::string& line) {
+  size_t position = 0;
+  for (int tabsToSkip = 8; tabsToSkip > 0; --tabsToSkip) {
+    position = line.find('\t', position);
+    if (position == std::string::npos) {
+      return std::string::npos;
+    }
+    ++position;
+  }
+  return position;
+}
+
+Event::Event(const std::string& line) : Event(line, -1) {
+}
+
+Event::Event(const std::string& line, long long lineOffset) : m_lineOffset(lineOffset) {
   std::stringstream ss;
   ss << line;
   std::string chromosomeName;
@@ -164,12 +205,25 @@ Event::Event(const std::string& line) {
 
   ss >> m_ref;
   ss >> m_alt;
+  m_symbolicSize = -1;
+  if (isSymbolicAllele(m_alt)) {
+    std::string info;
+    ss >> dummy >> dummy >> info; // skip QUAL and FILTER
+    m_symbolicSize = getSymbolicEventSize(info, position);
+    if (getType() == INS) {
+      findInfoValue(info, "SEQ", m_insertedSequence);
+    }
+  } else if (getType() == INS) {
+    m_insertedSequence = m_alt.substr(m_ref.length());
+  }
 }
 
 Event::Event(const Coordinate& coordinate, const std::string& ref, const std::string& alt) {
   m_coordinate = coordinate;
   m_ref = ref;
   m_alt = alt;
+  m_symbolicSize = -1;
+  m_lineOffset = -1;
 }
 
 Coordinate Event::getCoordinate() const {
@@ -181,27 +235,35 @@ bool operator<(const Event& leftEvent, const Event& rightEvent) {
 }
 
 EventType Event::getType() const {
-  if (m_ref.length() == 1 ) {
-    if (m_alt.length() == 1) {
-      return SNP;
-    } else {
-      if (isPureInsertion(m_ref, m_alt)) {
-        return INS;
-      }
-    }
-  } else {
-    // reference length > 0
-    if (isPureDeletion(m_ref, m_alt)) {
+  switch (classifyEvent(m_ref, m_alt)) {
+    case INSERTION_CLASS:
+      return INS;
+    case DELETION_CLASS:
       return DEL;
-    }
+    case SNP_CLASS:
+      return SNP;
+    default:
+      return RPL;
   }
-  return RPL;
 }
 
 int Event::getSize() const {
-  return abs(m_ref.length() - m_alt.length());
+  if (isSymbolicAllele(m_alt)) {
+    return m_symbolicSize;
+  }
+  int refLength = m_ref.length();
+  int altLength = m_alt.length();
+  return abs(refLength - altLength);
 } 
 
+const std::string& Event::getInsertedSequence() const {
+  return m_insertedSequence;
+}
+
+long long Event::getLineOffset() const {
+  return m_lineOffset;
+}
+
 std::ostream& operator<<(std::ostream& os, const Event& event) {
   os << event.getCoordinate().getChromosomeName() << "\t" << 
         event.getCoordinate().getPosition() << "\t" <<
@@ -210,8 +272,175 @@ std::ostream& operator<<(std::ostream& os, const Event& event) {
   return os;
 }
 
+/**
+ * 'IntervalIndex' finds all intervals that overlap a query interval in
+ * O(log n + number of overlaps). The intervals are sorted by start and form an
+ * implicit binary tree (the node at index i has its children at i -/+ 2^(k-1),
+ * with k the number of trailing 1-bits of i), in which every node knows the
+ * largest end in its subtree, so subtrees that end before the query are skipped.
+ * Intervals are half-open: [start, end).
+ */
+class IntervalIndex {
+public:
+  IntervalIndex();
+  void add(int start, int end, int eventIndex);
+  void build();
+  void findOverlaps(int start, int end, std::vector<int>& eventIndices) const;
+
+private:
+  struct Interval {
+    int start_;
+    int end_;
+    int maxEnd_; // the largest end in the subtree of this interval
+    int eventIndex_;
+  };
+  friend bool operator<(const Interval& leftInterval, const Interval& rightInterval);
+
+  std::vector<Interval> intervals_;
+  int maxLevel_;
+};
+
+bool operator<(const IntervalIndex::Interval& leftInterval, const IntervalIndex::Interval& rightInterval) {
+  return leftInterval.start_ < rightInterval.start_;
+}
+
+IntervalIndex::IntervalIndex() : maxLevel_(-1) {
+}
+
+void IntervalIndex::add(int start, int end, int eventIndex) {
+  Interval interval;
+  interval.start_ = start;
+  interval.end_ = end;
+  interval.maxEnd_ = end;
+  interval.eventIndex_ = eventIndex;
+  intervals_.push_back(interval);
+}
+
+void IntervalIndex::build() {
+  std::sort(intervals_.begin(), intervals_.end());
+  int numberOfIntervals = intervals_.size();
+  if (numberOfIntervals == 0) {
+    maxLevel_ = -1;
+    return;
+  }
+  int lastIndex = 0; // the last node of the current level, which may have an incomplete subtree
+  int lastMaxEnd = 0;
+  for (int i = 0; i < numberOfIntervals; i += 2) { // the leaves
+    lastIndex = i;
+    lastMaxEnd = intervals_[i].maxEnd_ = intervals_[i].end_;
+  }
+  int level = 1;
+  for (; (1 << level) <= numberOfIntervals; ++level) {
+    int halfStep = 1 << (level - 1);
+    for (int i = (halfStep << 1) - 1; i < numberOfIntervals; i += halfStep << 2) {
+      int leftMaxEnd = intervals_[i - halfStep].maxEnd_;
+      int rightMaxEnd = (i + halfStep < numberOfIntervals) ? intervals_[i + halfStep].maxEnd_ : lastMaxEnd;
+      intervals_[i].maxEnd_ = std::max(intervals_[i].end_, std::max(leftMaxEnd, rightMaxEnd));
+    }
+    lastIndex = ((lastIndex >> level) & 1) ? lastIndex - halfStep : lastIndex + halfStep;
+    if (lastIndex < numberOfIntervals && intervals_[lastIndex].maxEnd_ > lastMaxEnd) {
+      lastMaxEnd = intervals_[lastIndex].maxEnd_;
+    }
+  }
+  maxLevel_ = level - 1;
+}
+
+void IntervalIndex::findOverlaps(int start, int end, std::vector<int>& eventIndices) const {
+  eventIndices.clear();
+  if (maxLevel_ < 0) {
+    return;
+  }
+  struct StackItem {
+    int index_;
+    int level_;
+    bool isLeftDone_;
+  };
+  int numberOfIntervals = intervals_.size();
+  StackItem stack[64];
+  int stackSize = 0;
+  StackItem root = { (1 << maxLevel_) - 1, maxLevel_, false };
+  stack[stackSize++] = root;
+  while (stackSize > 0) {
+    StackItem item = stack[--stackSize];
+    if (item.level_ <= 3) {
+      // small subtree: scan its intervals
+      int firstIndex = item.index_ >> item.level_ << item.level_;
+      int endIndex = std::min(firstIndex + (1 << (item.level_ + 1)) - 1, numberOfIntervals);
+      for (int i = firstIndex; i < endIndex && intervals_[i].start_ < end; ++i) {
+        if (start < intervals_[i].end_) {
+          eventIndices.push_back(intervals_[i].eventIndex_);
+        }
+      }
+    } else if (!item.isLeftDone_) {
+      int leftChild = item.index_ - (1 << (item.level_ - 1));
+      StackItem revisit = { item.index_, item.level_, true };
+      stack[stackSize++] = revisit;
+      if (leftChild >= numberOfIntervals || intervals_[leftChild].maxEnd_ > start) {
+        StackItem left = { leftChild, item.level_ - 1, false };
+        stack[stackSize++] = left;
+      }
+    } else if (item.index_ < numberOfIntervals && intervals_[item.index_].start_ < end) {
+      if (start < intervals_[item.index_].end_) {
+        eventIndices.push_back(intervals_[item.index_].eventIndex_);
+      }
+      StackItem right = { item.index_ + (1 << (item.level_ - 1)), item.level_ - 1, false };
+      stack[stackSize++] = right;
+    }
+  }
+}
+
+/** The deleted bases of a deletion, as half-open interval; false if the event is no deletion of known size **/
+bool getDeletedSpan(const Event& event, int& start, int& end) {
+  if (event.getType() != DEL || event.getSize() <= 0) {
+    return false;
+  }
+  start = event.getCoordinate().getPosition() + 1;
+  end = start + event.getSize();
+  return true;
+}
+
+/**
+ * Finds a deletion in the second file that overlaps at least minimumOverlap of both itself and this deletion;
+ * returns its index in 'events', or -1 if there is none.
+ */
+int findReciprocalOverlap(const Event& deletion, const std::vector<Event>& events,
+    const std::map<int, IntervalIndex>& deletionIndices, double minimumOverlap) {
+  int start = 0;
+  int end = 0;
+  getDeletedSpan(deletion, start, end);
+  std::map<int, IntervalIndex>::const_iterator indexIt =
+    deletionIndices.find(chromosomeNameToIndex(deletion.getCoordinate().getChromosomeName()));
+  if (indexIt == deletionIndices.end()) {
+    return -1;
+  }
+  std::vector<int> overlappingEvents;
+  indexIt->second.findOverlaps(start, end, overlappingEvents);
+  for (int i = 0; i < overlappingEvents.size(); ++i) {
+    int otherStart = 0;
+    int otherEnd = 0;
+    getDeletedSpan(events[overlappingEvents[i]], otherStart, otherEnd);
+    int overlap = std::min(end, otherEnd) - std::max(start, otherStart);
+    if (overlap >= minimumOverlap * (end - start) && overlap >= minimumOverlap * (otherEnd - otherStart)) {
+      return overlappingEvents[i];
+    }
+  }
+  return -1;
+}
+
+/** Are the inserted sequences at least minimumSimilarity similar? Insertions of which a sequence is unknown pass. **/
+bool haveSimilarSequences(const Event& currentEvent, const Event& soughtEvent, double minimumSimilarity) {
+  const std::string& currentSequence = currentEvent.getInsertedSequence();
+  const std::string& soughtSequence = soughtEvent.getInsertedSequence();
+  if (currentSequence.empty() || soughtSequence.empty()) {
+    return true;
+  }
+  int longestLength = std::max(currentSequence.length(), soughtSequence.length());
+  int maxDistance = (1.0 - minimumSimilarity) * longestLength;
+  return editDistance(currentSequence, soughtSequence, maxDistance) <= maxDistance;
+}
+
 bool sufficientlySimilar(const Event& currentEvent, const Event& soughtEvent, 
-    int differenceDefiningDistance, bool requireSameSize) {
+    int differenceDefiningDistance, bool requireSameSize, double minimumSimilarity) {
   if (currentEvent.getType() != soughtEvent.getType()) {
     return false;
   }
@@ -220,11 +449,242 @@ bool sufficientlySimilar(const Event& currentEvent, const Event& soughtEvent,
       return false;
     }
   }
+  if (minimumSimilarity > 0 && currentEvent.getType() == INS &&
+      !haveSimilarSequences(currentEvent, soughtEvent, minimumSimilarity)) {
+    return false;
+  }
   return (currentEvent.getCoordinate().getDistanceBetween(soughtEvent.getCoordinate()) < differenceDefiningDistance);
 }
 
+enum GenotypeClass { HOM_REF, HET, HOM_ALT, NO_CALL };
+const int NUMBER_OF_GENOTYPE_CLASSES = 4;
+const char* const GENOTYPE_CLASS_NAMES[NUMBER_OF_GENOTYPE_CLASSES] = { "0/0", "0/1", "1/1", "./." };
+
+/** Classifies a GT value like "0|1" or "1/2", which ends at a ':', a tab or the end of the line **/
+GenotypeClass classifyGenotype(const char* genotype) {
+  bool hasReference = false;
+  bool hasAlternative = false;
+  bool hasTwoAlternatives = false;
+  int firstAlternative = 0;
+  while (*genotype != ':' && *genotype != '\t' && *genotype != '\0') {
+    if (*genotype == '.') {
+      return NO_CALL;
+    }
+    if (isdigit(*genotype)) {
+      int allele = 0;
+      for (; isdigit(*genotype); ++genotype) {
+        allele = allele * 10 + (*genotype - '0');
+      }
+      if (allele == 0) {
+        hasReference = true;
+      } else if (!hasAlternative) {
+        hasAlternative = true;
+        firstAlternative = allele;
+      } else if (allele != firstAlternative) {
+        hasTwoAlternatives = true;
+      }
+      continue;
+    }
+    ++genotype; // a '/' or '|'
+  }
+  if (!hasReference && !hasAlternative) {
+    return NO_CALL;
+  }
+  if (!hasAlternative) {
+    return HOM_REF;
+  }
+  return (hasReference || hasTwoAlternatives) ? HET : HOM_ALT;
+}
+
+/**
+ * Classifies the GT of every sample in the FORMAT-and-samples part of a VCF line, in one pass over the
+ * line: each sample column is only scanned up to its GT subfield and the next tab, and nothing is copied
+ * or split. Samples without a GT subfield are NO_CALL; if FORMAT has no GT, no classes are given.
+ */
+void classifyGenotypes(const char* sampleColumns, std::vector<GenotypeClass>& genotypeClasses) {
+  genotypeClasses.clear();
+  const char* position = sampleColumns;
+  int genotypeIndex = 0;
+  while (!(position[0] == 'G' && position[1] == 'T' && (position[2] == ':' || position[2] == '\t'))) {
+    while (*position != ':' && *position != '\t' && *position != '\0') {
+      ++position;
+    }
+    if (*position != ':') {
+      return; // no GT in FORMAT
+    }
+    ++position;
+    ++genotypeIndex;
+  }
+  position = strchr(position, '\t');
+  while (position != NULL) {
+    ++position;
+    int colonsToSkip = genotypeIndex;
+    while (colonsToSkip > 0 && *position != '\t' && *position != '\0') {
+      if (*position == ':') {
+        --colonsToSkip;
+      }
+      ++position;
+    }
+    // trailing subfields may be dropped, so a sample can lack GT
+    genotypeClasses.push_back((colonsToSkip == 0) ? classifyGenotype(position) : NO_CALL);
+    position = strchr(position, '\t');
+  }
+}
+
+/** The sample names in a "#CHROM" header line **/
+std::vector<std::string> getSampleNames(const std::string& headerLine) {
+  std::vector<std::string> sampleNames;
+  size_t formatStart = findFormatColumn(headerLine);
+  if (formatStart == std::string::npos) {
+    return sampleNames;
+  }
+  size_t nameStart = headerLine.find('\t', formatStart);
+  while (nameStart != std::string::npos) {
+    ++nameStart;
+    size_t nameEnd = headerLine.find('\t', nameStart);
+    sampleNames.push_back(headerLine.substr(nameStart, (nameEnd == std::string::npos) ? nameEnd : nameEnd - nameStart));
+    nameStart = nameEnd;
+  }
+  return sampleNames;
+}
+
+/**
+ * 'GenotypeConcordance' counts, per sample, how the genotypes of the found events relate
+ * to those of the events they matched in the second file.
+ */
+class GenotypeConcordance {
+public:
+  GenotypeConcordance();
+  void setSamples(const std::string& comparedHeader, const std::string& comparisonHeader);
+  void setComparisonFile(const std::string& nameOfComparisonFile);
+  void addPair(const std::string& comparedLine, const Event& matchedEvent);
+  void write(const std::string& nameOfOutputFile) const;
+
+private:
+  GenotypeClass getClass(const std::vector<GenotypeClass>& genotypeClasses, int sampleIndex) const;
+
+  // the lines of the second file are read back (by their offsets) when their events are matched, so
+  // their sample columns need not be kept in memory
+  std::ifstream m_comparisonFile;
+  long long m_offsetOfComparisonLine; // of the line whose classes are in m_comparisonClasses
+  std::string m_comparisonLine;
+  std::vector<GenotypeClass> m_comparedClasses;
+  std::vector<GenotypeClass> m_comparisonClasses;
+  std::vector<std::string> m_sampleNames;
+  std::vector<int> m_comparisonSampleIndices; // for each sample of the first file
+  std::vector<std::vector<long long> > m_counts; // per sample: first file class * 4 + second file class
+};
+
+GenotypeConcordance::GenotypeConcordance() : m_offsetOfComparisonLine(-1) {
+}
+
+void GenotypeConcordance::setComparisonFile(const std::string& nameOfComparisonFile) {
+  m_comparisonFile.open(nameOfComparisonFile.c_str());
+}
+
+/** Pairs the samples of both files by name, or by column if they have no names in common **/
+void GenotypeConcordance::setSamples(const std::string& comparedHeader, const std::string& comparisonHeader) {
+  m_sampleNames = getSampleNames(comparedHeader);
+  std::vector<std::string> comparisonNames = getSampleNames(comparisonHeader);
+  m_comparisonSampleIndices.assign(m_sampleNames.size(), -1);
+  bool haveCommonNames = false;
+  for (int sampleIndex = 0; sampleIndex < m_sampleNames.size(); ++sampleIndex) {
+    for (int otherIndex = 0; otherIndex < comparisonNames.size(); ++otherIndex) {
+      if (m_sampleNames[sampleIndex] == comparisonNames[otherIndex]) {
+        m_comparisonSampleIndices[sampleIndex] = otherIndex;
+        haveCommonNames = true;
+        break;
+      }
+    }
+  }
+  if (!haveCommonNames) {
+    for (int sampleIndex = 0; sampleIndex < m_sampleNames.size() && sampleIndex < comparisonNames.size();
+        ++sampleIndex) {
+      m_comparisonSampleIndices[sampleIndex] = sampleIndex;
+    }
+  }
+  m_counts.assign(m_sampleNames.size(), std::vector<long long>(NUMBER_OF_GENOTYPE_CLASSES * NUMBER_OF_GENOTYPE_CLASSES, 0));
+}
+
+GenotypeClass GenotypeConcordance::getClass(const std::vector<GenotypeClass>& genotypeClasses, int sampleIndex) const {
+  return (sampleIndex < genotypeClasses.size()) ? genotypeClasses[sampleIndex] : NO_CALL;
+}
+
+/** Classifies the genotypes of both lines once, in a single pass over each, and then counts them per sample **/
+void GenotypeConcordance::addPair(const std::string& comparedLine, const Event& matchedEvent) {
+  size_t formatStart = findFormatColumn(comparedLine);
+  if (formatStart == std::string::npos) {
+    return;
+  }
+  classifyGenotypes(comparedLine.c_str() + formatStart, m_comparedClasses);
+  if (matchedEvent.getLineOffset() != m_offsetOfComparisonLine) {
+    // consecutive events often match the same event, whose classes are then still known
+    m_offsetOfComparisonLine = matchedEvent.getLineOffset();
+    m_comparisonFile.clear();
+    m_comparisonFile.seekg(m_offsetOfComparisonLine);
+    getline(m_comparisonFile, m_comparisonLine);
+    size_t comparisonFormatStart = findFormatColumn(m_comparisonLine);
+    m_comparisonClasses.clear();
+    if (comparisonFormatStart != std::string::npos) {
+      classifyGenotypes(m_comparisonLine.c_str() + comparisonFormatStart, m_comparisonClasses);
+    }
+  }
+  for (int sampleIndex = 0; sampleIndex < m_sampleNames.size(); ++sampleIndex) {
+    if (m_comparisonSampleIndices[sampleIndex] < 0) {
+      continue;
+    }
+    GenotypeClass comparedClass = getClass(m_comparedClasses, sampleIndex);
+    GenotypeClass comparisonClass = getClass(m_comparisonClasses, m_comparisonSampleIndices[sampleIndex]);
+    ++m_counts[sampleIndex][comparedClass * NUMBER_OF_GENOTYPE_CLASSES + comparisonClass];
+  }
+}
+
+/** Writes a matrix per sample: rows are the genotypes in the first file, columns those in the second file **/
+void GenotypeConcordance::write(const std::string& nameOfOutputFile) const {
+  std::ofstream outputFile(nameOfOutputFile.c_str());
+  outputFile << "sample\tfirst\\second";
+  for (int columnClass = 0; columnClass < NUMBER_OF_GENOTYPE_CLASSES; ++columnClass) {
+    outputFile << "\t" << GENOTYPE_CLASS_NAMES[columnClass];
+  }
+  outputFile << "\n";
+  for (int sampleIndex = 0; sampleIndex < m_sampleNames.size(); ++sampleIndex) {
+    if (m_comparisonSampleIndices[sampleIndex] < 0) {
+      continue;
+    }
+    for (int rowClass = 0; rowClass < NUMBER_OF_GENOTYPE_CLASSES; ++rowClass) {
+      outputFile << m_sampleNames[sampleIndex] << "\t" << GENOTYPE_CLASS_NAMES[rowClass];
+      for (int columnClass = 0; columnClass < NUMBER_OF_GENOTYPE_CLASSES; ++columnClass) {
+        outputFile << "\t" << m_counts[sampleIndex][rowClass * NUMBER_OF_GENOTYPE_CLASSES + columnClass];
+      }
+      outputFile << "\n";
+    }
+  }
+  outputFile.close();
+}
+
+/** The options that follow the fixed arguments of compare **/
+struct CompareOptions {
+  double minimumOverlap_; // -r; 0 if deletions are matched by distance
+  double minimumSimilarity_; // -s; 0 if inserted sequences are not compared
+  std::string nameOfReference_; // -h; empty if events are not replayed
+  int numberOfThreads_; // -t
+  std::string nameOfConcordanceFile_; // -g; empty if genotypes are not compared
+};
+
 void transformFile(const std::string& nameOfComparedFile, const std::string& nameOfComparisonFile, 
-    int wiggleRoom, bool requireIdenticalLengths, const std::string& nameOfOutputFile) {
+    int wiggleRoom, bool requireIdenticalLengths, const CompareOptions& options,
+    const std::string& nameOfOutputFile) {
+  double minimumOverlap = options.minimumOverlap_;
+  double minimumSimilarity = options.minimumSimilarity_;
+  bool compareGenotypes = !options.nameOfConcordanceFile_.empty();
+  GenotypeConcordance concordance;
+  std::string comparisonHeader = "";
+  std::vector<ReplayResult> replayResults;
+  if (!options.nameOfReference_.empty()) {
+    replayResults = replayClusters(nameOfComparedFile, nameOfComparisonFile, options.nameOfReference_, wiggleRoom,
+      options.numberOfThreads_);
+  }
+
   std::ifstream comparedFile(nameOfComparedFile.c_str());
   std::ifstream comparisonFile(nameOfComparisonFile.c_str());
   std::ofstream outputFile(nameOfOutputFile.c_str());
@@ -234,10 +694,13 @@ void transformFile(const std::string& nameOfComparedFile, const std::string& nam
 
   std::vector<Event> events;
 
+  long long lineOffset = 0;
   while (!comparisonFile.eof()) {
     std::string line;
     std::stringstream buffer_ss;
+    long long offsetOfLine = lineOffset;
     getline(comparisonFile, line );
+    lineOffset += line.length() + 1;
     if (line.length() == 0) {
       break;
     }
@@ -245,12 +708,33 @@ void transformFile(const std::string& nameOfComparedFile, const std::string& nam
     // skip lines beginning with '#'
     const char START_OF_COMMENT_CHAR = '#';
     if (StringStartsWith(line,"#" )) {
+      if (StringStartsWith(line, "#CHROM")) {
+        comparisonHeader = line;
+      }
       continue;
     } else {
-      events.push_back(line);
+      events.push_back(Event(line, offsetOfLine));
+    }
+  }
+  std::stable_sort(events.begin(), events.end()); // the search below needs them in order
+
+  // with reciprocal overlap, deletions are looked up by their span, per chromosome
+  std::map<int, IntervalIndex> deletionIndices;
+  if (minimumOverlap > 0) {
+    for (int eventIndex = 0; eventIndex < events.size(); ++eventIndex) {
+      int start = 0;
+      int end = 0;
+      if (getDeletedSpan(events[eventIndex], start, end)) {
+        int chromosomeIndex = chromosomeNameToIndex(events[eventIndex].getCoordinate().getChromosomeName());
+        deletionIndices[chromosomeIndex].add(start, end, eventIndex);
+      }
+    }
+    for (std::map<int, IntervalIndex>::iterator it = deletionIndices.begin(); it != deletionIndices.end(); ++it) {
+      it->second.build();
     }
   }
 
+  int recordIndex = 0;
   while (!comparedFile.eof()) {
     std::string line;
     std::stringstream buffer_ss;
@@ -262,11 +746,36 @@ void transformFile(const std::string& nameOfComparedFile, const std::string& nam
     // skip lines beginning with '#'
     const char START_OF_COMMENT_CHAR = '#';
     if (StringStartsWith(line,"#" )) {
+      if (compareGenotypes && StringStartsWith(line, "#CHROM")) {
+        concordance.setSamples(line, comparisonHeader);
+        concordance.setComparisonFile(nameOfComparisonFile);
+      }
       outputFile << line << "\n";
       continue;
     } 
     
+    ReplayResult replayResult = (recordIndex < replayResults.size()) ? replayResults[recordIndex] : NOT_REPLAYABLE;
+    ++recordIndex;
+    if (replayResult == REPLAY_MATCH) {
+      outputFile << line << "\n";
+      continue;
+    }
+    // events whose replay found no match may still match by distance and size, like two large deletions
+    // with slightly different breakpoints, so they are compared the usual way too
+
     Event currentEvent(line);
+    int start = 0;
+    int end = 0;
+    if (minimumOverlap > 0 && getDeletedSpan(currentEvent, start, end)) {
+      int matchIndex = findReciprocalOverlap(currentEvent, events, deletionIndices, minimumOverlap);
+      if (matchIndex >= 0) {
+        outputFile << line << "\n";
+        if (compareGenotypes) {
+          concordance.addPair(line, events[matchIndex]);
+        }
+      }
+      continue;
+    }
     Coordinate lowerSearchBound = currentEvent.getCoordinate().getDecreasedCoordinate(wiggleRoom);
     Event lowerSearchDummyEvent(lowerSearchBound, "", "");
 
@@ -276,25 +785,81 @@ void transformFile(const std::string& nameOfComparedFile, const std::string& nam
     std::vector<Event>::iterator eventToSearch = firstEventToSearch;
     std::vector<Event>::iterator bestEventIt = firstEventToSearch;
     int minDistance = wiggleRoom;
-    while (eventToSearch->getCoordinate().withinDistance(currentEvent.getCoordinate(), wiggleRoom)) {
-      if (sufficientlySimilar(*eventToSearch, currentEvent, wiggleRoom, requireIdenticalLengths)) {
+    while (eventToSearch != events.end() && eventToSearch->getCoordinate().withinDistance(currentEvent.getCoordinate(), wiggleRoom)) {
+      int distance = eventToSearch->getCoordinate().getDistanceBetween(currentEvent.getCoordinate());
+      if (distance < minDistance &&
+          sufficientlySimilar(*eventToSearch, currentEvent, wiggleRoom, requireIdenticalLengths, minimumSimilarity)) {
          bestEventIt = eventToSearch;
-         minDistance = eventToSearch->getCoordinate().getDistanceBetween(currentEvent.getCoordinate());
+         minDistance = distance;
       } // if this event is a better match
       ++eventToSearch;
     } // while the event is still in the valid space
     if (minDistance < wiggleRoom) {
       outputFile << line << "\n";
+      if (compareGenotypes) {
+        concordance.addPair(line, *bestEventIt);
+      }
     }
   }
+  if (compareGenotypes) {
+    concordance.write(options.nameOfConcordanceFile_);
+  }
   
   comparedFile.close();
   comparisonFile.close();
   outputFile.close();
 }
 
+/**
+ * Reads the options (-r fraction, -s fraction, -h reference, -t threads, -g matrix_file) after the fixed
+ * arguments; false if they are invalid
+ */
+bool readOptions(int argc, char** argv, CompareOptions& options) {
+  options.minimumOverlap_ = 0.0;
+  options.minimumSimilarity_ = 0.0;
+  options.nameOfReference_ = "";
+  options.numberOfThreads_ = 1;
+  options.nameOfConcordanceFile_ = "";
+  for (int argumentIndex = 6; argumentIndex < argc; argumentIndex += 2) {
+    std::string option = argv[argumentIndex];
+    if (argumentIndex + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[argumentIndex + 1];
+    if (option == "-h") {
+      options.nameOfReference_ = value;
+      continue;
+    } else if (option == "-g") {
+      options.nameOfConcordanceFile_ = value;
+      continue;
+    } else if (option == "-t") {
+      options.numberOfThreads_ = atoi(value.c_str());
+      if (options.numberOfThreads_ < 1) {
+        return false;
+      }
+      continue;
+    }
+    double fraction = atof(value.c_str());
+    if (fraction <= 0 || fraction > 1) {
+      return false;
+    }
+    if (option == "-r") {
+      options.minimumOverlap_ = fraction;
+    } else if (option == "-s") {
+      options.minimumSimilarity_ = fraction;
+    } else {
+      return false;
+    }
+  }
+  return options.nameOfReference_.empty() || options.nameOfConcordanceFile_.empty();
+}
+
 bool argumentsCorrect(int argc, char** argv) {
-  if (argc != 6) {
+  if (argc < 6) {
+    return false;
+  }
+  CompareOptions options;
+  if (!readOptions(argc, argv, options)) {
     return false;
   }
   if (atoi(argv[3]) == 0) {
@@ -318,11 +883,30 @@ int main(int argc, char** argv) {
       "(similar location, same or similar SV-length) in the second file. Additional arguments "
       "indicate what difference in location is considered similar enough (or rather: which is "
       "the minimum distance at which events are considered dissimilar), and whether one should "
-      "ignore SV lengths in the comparison ('same_len' or 'ignore_len').\n" 
+      "ignore SV lengths in the comparison ('same_len' or 'ignore_len'). Events with a symbolic allele "
+      "(<DEL>, <INS>) are compared by their SVLEN (or END), so \"T <DEL>\" with SVLEN=-3 matches \"TACG T\".\n" 
       "\n"
-      "Usage: ./compare first_vcf second_vcf wiggle_room_bp whether_compare_lengths merged_vcf\n"
+      "Usage: ./compare first_vcf second_vcf wiggle_room_bp whether_compare_lengths merged_vcf [-r fraction] [-s fraction] [-h reference [-t threads]] [-g matrix_file]\n"
       "Example: ./compare pacbio_deletions.vcf freebayes_deletions.vcf 10 same_len pacbio_del_found_by_freebayes.vcf\n"
       "\n"
+      "-r: match deletions by reciprocal overlap instead of by distance and length: a deletion is found if a "
+      "deletion in the second file overlaps at least this fraction (like 0.5) of both deletions. Other events "
+      "are compared as usual.\n"
+      "-s: insertions only match if their inserted sequences (the ALT after the REF base, or SEQ= for <INS>) "
+      "are at least this similar: 1 - edit distance / length of the longer sequence. Insertions without a "
+      "known sequence are compared as usual.\n"
+      "-h: match events by haplotype replay against this reference (FASTA or 2bit): events of both files "
+      "within wiggle_room_bp of each other form a cluster, and an event is found if, with other events of its "
+      "cluster, it spells the same sequence as some events of the second file in that cluster. This matches "
+      "events that are written differently, like a complex indel and an SNP plus indel, or shifted repeat "
+      "indels. Events whose replay finds no match, and events that cannot be replayed (symbolic alleles, "
+      "several ALT alleles, REF not matching the reference), are compared as usual, so -h only adds matches.\n"
+      "-t: the number of threads with which the clusters are replayed (default 1).\n"
+      "-g: compare the genotypes (GT) of each found event and the event it matched, and write a confusion "
+      "matrix of 0/0, 0/1, 1/1 and ./. per sample to this file (rows: first file, columns: second file). "
+      "Samples are paired by name, or by column if the files have no sample names in common. Cannot be "
+      "combined with -h.\n"
+      "\n"
       "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
     return -1;
   } else {
@@ -332,7 +916,10 @@ int main(int argc, char** argv) {
     std::string lengthConsideration = argv[4];
     bool requireIdenticalLengths = (lengthConsideration == "same_len");
     std::string nameOfOutputFile = argv[5];
-    transformFile(nameOfFirstInputFile, nameOfSecondInputFile, wiggleRoom, requireIdenticalLengths, nameOfOutputFile);
+    CompareOptions options;
+    readOptions(argc, argv, options);
+    transformFile(nameOfFirstInputFile, nameOfSecondInputFile, wiggleRoom, requireIdenticalLengths, options,
+      nameOfOutputFile);
     return 0;
   }
 }
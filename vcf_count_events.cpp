@@ -0,0 +1,177 @@
+/**
+  vcf_count_events.cpp
+
+  Purpose: counts the number of events (insertions, deletions, SNPs, whatever) in a VCF file, so all
+  lines except the header lines (those starting with '#'). The file may be plain or compressed (BGZF, as
+  made by bgzip, or ordinary gzip). With -t N, N threads count different parts of the file. With -c, the
+  count is given per chromosome; with -e, it is divided into insertions, deletions, SNPs and replacements,
+  classified as compare does. The table then has a row per chromosome (-c) and a total row.
+
+  usage: ./count_events input_vcf [-t number_of_threads] [-c] [-e]
+  example: ./count_events gatk_hanchild.vcf
+  example: ./count_events gatk_hanchild.vcf.gz -t 4 -c -e
+
+  contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
+**/
+
+#include <cstdlib> // atoi
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "chunked_input.h"
+#include "event_type.h"
+
+/** Counts the events among the lines of one thread; without breakdown, only the lines are counted **/
+class EventCounter : public LineHandler {
+public:
+  EventCounter(bool countPerChromosome, bool countPerClass) : countPerChromosome_(countPerChromosome),
+      countPerClass_(countPerClass), currentCounts_(NULL) {
+  }
+
+  void handleLine(const char* start, const char* end) {
+    if (start == end || *start == '#') {
+      return;
+    }
+    if (!countPerChromosome_ && !countPerClass_) {
+      ++totalCounts_.numberOfRecords_;
+      return;
+    }
+    const char* fieldStarts[5];
+    const char* fieldEnds[5];
+    splitFields(start, end, 5, fieldStarts, fieldEnds);
+    if (countPerChromosome_ && (currentCounts_ == NULL ||
+        chromosomeName_.compare(0, std::string::npos, start, fieldEnds[0] - start) != 0)) {
+      // VCF files are normally sorted, so the chromosome is mostly that of the previous line
+      chromosomeName_.assign(start, fieldEnds[0]);
+      std::map<std::string, EventCounts>::iterator countsIt = chromosomeCounts_.find(chromosomeName_);
+      if (countsIt == chromosomeCounts_.end()) {
+        chromosomeOrder_.push_back(chromosomeName_);
+        countsIt = chromosomeCounts_.insert(std::make_pair(chromosomeName_, EventCounts())).first;
+      }
+      currentCounts_ = &countsIt->second;
+    }
+    EventCounts& counts = countPerChromosome_ ? *currentCounts_ : totalCounts_;
+    ++counts.numberOfRecords_;
+    if (countPerClass_) {
+      referenceAllele_.assign(fieldStarts[3], fieldEnds[3]);
+      alternativeAllele_.assign(fieldStarts[4], fieldEnds[4]);
+      ++counts.numberPerClass_[classifyEvent(referenceAllele_, alternativeAllele_)];
+    }
+  }
+
+  bool countPerChromosome_;
+  bool countPerClass_;
+  EventCounts totalCounts_; // only used without per-chromosome counts
+  std::map<std::string, EventCounts> chromosomeCounts_;
+  std::vector<std::string> chromosomeOrder_; // in the order in which this thread met them
+
+private:
+  EventCounts* currentCounts_; // those of chromosomeName_
+  std::string chromosomeName_;
+  std::string referenceAllele_;
+  std::string alternativeAllele_;
+};
+
+void writeCounts(const std::string& name, const EventCounts& counts, bool countPerClass) {
+  std::cout << name << "\t" << counts.numberOfRecords_;
+  if (countPerClass) {
+    for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+      std::cout << "\t" << counts.numberPerClass_[eventClass];
+    }
+  }
+  std::cout << "\n";
+}
+
+/**
+ * Counts the events of the file with numberOfThreads threads and writes the result: only the number of
+ * events, or a table. The chromosomes are listed in the order of the file, as each thread reads a later
+ * part of the file than the previous one.
+ */
+void countEvents(const std::string& nameOfInputFile, int numberOfThreads, bool countPerChromosome,
+    bool countPerClass) {
+  ChunkedInput input(nameOfInputFile);
+  std::vector<EventCounter> counters(numberOfThreads, EventCounter(countPerChromosome, countPerClass));
+  std::vector<LineHandler*> handlers;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+    handlers.push_back(&counters[threadIndex]);
+  }
+  readLinesInParallel(input, handlers);
+
+  EventCounts totalCounts;
+  std::vector<std::string> chromosomeOrder;
+  std::map<std::string, EventCounts> chromosomeCounts;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+    const EventCounter& counter = counters[threadIndex];
+    totalCounts.add(counter.totalCounts_);
+    for (int i = 0; i < counter.chromosomeOrder_.size(); ++i) {
+      const std::string& chromosomeName = counter.chromosomeOrder_[i];
+      if (chromosomeCounts.find(chromosomeName) == chromosomeCounts.end()) {
+        chromosomeOrder.push_back(chromosomeName);
+      }
+      const EventCounts& counts = counter.chromosomeCounts_.find(chromosomeName)->second;
+      chromosomeCounts[chromosomeName].add(counts);
+      totalCounts.add(counts);
+    }
+  }
+
+  if (!countPerChromosome && !countPerClass) {
+    std::cout << totalCounts.numberOfRecords_ << "\n";
+    return;
+  }
+  std::cout << "#chromosome\tevents";
+  if (countPerClass) {
+    for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+      std::cout << "\t" << getEventClassName(static_cast<EventClass>(eventClass));
+    }
+  }
+  std::cout << "\n";
+  for (int i = 0; i < chromosomeOrder.size(); ++i) {
+    writeCounts(chromosomeOrder[i], chromosomeCounts[chromosomeOrder[i]], countPerClass);
+  }
+  writeCounts("total", totalCounts, countPerClass);
+}
+
+
+int main(int argc, char** argv) {
+  if (argc < 2) { std::cout <<
+    "count_events\n"
+    "\n"
+    "Purpose: counts the number of events (insertions, deletions, SNPs, whatever) in a VCF file, so all "
+    "lines except the header lines (those starting with '#'). The file may be plain or compressed (BGZF, as "
+    "made by bgzip, or ordinary gzip). With -t N, N threads count different parts of the file. With -c, the "
+    "count is given per chromosome; with -e, it is divided into insertions, deletions, SNPs and replacements, "
+    "classified as compare does. The table then has a row per chromosome (-c) and a total row.\n"
+    "\n"
+    "usage: ./count_events input_vcf [-t number_of_threads] [-c] [-e]\n"
+    "example: ./count_events gatk_hanchild.vcf\n"
+    "example: ./count_events gatk_hanchild.vcf.gz -t 4 -c -e\n"
+    "\n"
+    "contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
+    return -1;
+  }
+  std::string nameOfInputFile = argv[1];
+  int numberOfThreads = 1;
+  bool countPerChromosome = false;
+  bool countPerClass = false;
+  for (int argumentIndex = 2; argumentIndex < argc; ++argumentIndex) {
+    std::string option = argv[argumentIndex];
+    if (option == "-t" && argumentIndex + 1 < argc) {
+      numberOfThreads = atoi(argv[++argumentIndex]);
+      if (numberOfThreads < 1) {
+        std::cout << "count_events error: the number of threads should be at least 1." << std::endl;
+        return -1;
+      }
+    } else if (option == "-c") {
+      countPerChromosome = true;
+    } else if (option == "-e") {
+      countPerClass = true;
+    } else {
+      std::cout << "count_events error: unknown or incomplete option " << option << std::endl;
+      return -1;
+    }
+  }
+  countEvents(nameOfInputFile, numberOfThreads, countPerChromosome, countPerClass);
+  return 0;
+}
@@ -2,7 +2,9 @@
   vcf_filter_eventtypes.cpp
 
   Purpose: does some basic filtering, like only keeping events with a certain
-  min length, max length, or event type (INS/DEL/SNP/ALL)
+  min length, max length, or event type (INS/DEL/SNP/ALL). Events with a symbolic
+  allele (like <DEL> or <INS>) get their size from SVLEN (or END) in the INFO field,
+  and their type from the allele.
  
   Usage: ./filter_eventtypes input_vcf min_size max_size event_type output_vcf
   Example: ./filter_eventtypes pacbio_hanchild.vcf 1 1000 ALL pacbio_hanchild_maxsize1000.vcf
@@ -16,6 +18,8 @@
 #include <sstream>
 #include <string>
 
+#include "symbolic_alleles.h"
+
 enum EventType {SNP, INS, DEL, ALL, INDEL};
 
 EventType stringToEventType(const std::string& eventTypeAsString) {
@@ -91,6 +95,22 @@ bool isEventType(const std::string& ref, const std::string& alt, EventType event
   }
 }
 
+/** Like isEventType, for events with a symbolic allele like <DEL> **/
+bool isSymbolicEventType(const std::string& alt, EventType eventType) {
+  std::string symbolicType = getSymbolicAlleleType(alt);
+  if (eventType == ALL) {
+    return true;
+  } else if (eventType == DEL) {
+    return symbolicType == "DEL";
+  } else if (eventType == INS) {
+    return symbolicType == "INS";
+  } else if (eventType == INDEL) {
+    return (symbolicType == "INS" || symbolicType == "DEL");
+  } else {
+    return false;
+  }
+}
+
 void transformFile(const std::string& nameOfInputFile, int minSize, int maxSize, EventType eventType, const std::string& nameOfOutputFile) {
   std::ifstream inputFile(nameOfInputFile.c_str());
   std::ofstream outputFile(nameOfOutputFile.c_str());
@@ -113,9 +133,8 @@ void transformFile(const std::string& nameOfInputFile, int minSize, int maxSize,
     buffer_ss << line;
     std::string dummy;
     
-    for (int i = 0; i < 3; i++ ) {
-       buffer_ss >> dummy;
-    }
+    int position;
+    buffer_ss >> dummy >> position >> dummy; // CHROM, POS and ID
     std::string ref;
     buffer_ss >> ref;
  
@@ -123,10 +142,17 @@ void transformFile(const std::string& nameOfInputFile, int minSize, int maxSize,
     buffer_ss >> alt;
 
     int sizeChange = changeInSize(ref,alt);
+    bool hasRightType = isEventType(ref, alt, eventType);
+    if (isSymbolicAllele(alt)) {
+      std::string info;
+      buffer_ss >> dummy >> dummy >> info; // skip QUAL and FILTER
+      sizeChange = getSymbolicEventSize(info, position);
+      hasRightType = isSymbolicEventType(alt, eventType);
+    }
 
     /*if (sizeChange == 1 || 
         (sizeChange < 4) && isHomopolymer(ref,alt)) {*/
-    if (sizeChange < minSize || sizeChange > maxSize || !isEventType(ref, alt, eventType)) {
+    if (sizeChange < minSize || sizeChange > maxSize || !hasRightType) {
       std::cout << "Filtered out: " << ref << ", " << alt << std::endl;
     } else {
       outputFile << line << std::endl;
@@ -154,7 +180,9 @@ int main(int argc, char** argv) {
       "filter_eventtypes\n"
       "\n"
       "Purpose: does some basic filtering, like only keeping events with a certain "
-      "min length, max length, or event type (INS/DEL/SNP/ALL/INDEL)\n"
+      "min length, max length, or event type (INS/DEL/SNP/ALL/INDEL). Events with a symbolic "
+      "allele (like <DEL> or <INS>) get their size from SVLEN (or END) in the INFO field, "
+      "and their type from the allele.\n"
       "\n"
       "Usage: ./filter_eventtypes input_vcf min_size max_size event_type output_vcf\n"
       "Example: ./filter_eventtypes pacbio_hanchild.vcf 1 1000 ALL pacbio_hanchild_maxsize1000.vcf\n"
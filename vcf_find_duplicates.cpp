@@ -3,16 +3,31 @@
 
   Purpose: finds all duplicate events (same chromosome, position, ref and alt) and writes a list containing them to standard output
 
-  usage: ./find_duplicates input_vcf 
+  By default only adjacent duplicates are found. With -r reference, every record gets a canonical key from
+  the reference: its leftmost, trimmed representation (like left_align gives), so "chr1 100 A AT" and the
+  same insertion written further to the right in an A-repeat have the same key. Duplicates are then found
+  anywhere in the file by hashing those keys; the records themselves are not changed, and each duplicate is
+  written as it is in the file. -t N computes the keys with N threads, -w reads the reference page by page.
+
+  usage: ./find_duplicates input_vcf [-r reference [-t number_of_threads] [-w]]
   example: ./find_duplicates gatk_hanchild.vcf > gatk_hanchild_duplicates.txt
+  example: ./find_duplicates merged_callers.vcf -r hg19.fa -t 8 > merged_callers_duplicates.txt
 
   contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
+#include <cctype> // toupper
+#include <cstdlib> // atoi
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "left_alignment.h"
+#include "reference.h"
 
 /* Returns whether a string starts with a certain other string, so if
    'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
@@ -97,6 +112,133 @@ void transformFile(const std::string& nameOfInputFile) {
 }
 
 
+/**
+ * 'KeyBatch' holds consecutive records of a single chromosome, so their canonical
+ * keys can be computed by several threads at once.
+ */
+struct KeyBatch {
+  std::string chromosomeName_;
+  std::vector<std::string> lines_;
+  std::vector<std::string> keys_;
+};
+
+// the number of records that is read before the worker threads compute their keys
+const int MAXIMUM_BATCH_SIZE = 65536;
+
+/** Returns a field of a tab-separated line, or "" if the line has fewer fields **/
+std::string getField(const std::string& line, int fieldIndex) {
+  size_t start = 0;
+  for (int i = 0; i < fieldIndex; ++i) {
+    start = line.find('\t', start);
+    if (start == std::string::npos) {
+      return "";
+    }
+    ++start;
+  }
+  size_t end = line.find('\t', start);
+  return line.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+}
+
+/**
+ * The canonical key of a record: CHROM, and the POS, REF and ALT alleles of the leftmost, trimmed
+ * representation, in capitals. Records that cannot be normalized (symbolic alleles, a REF that
+ * differs from the reference) keep their own POS, REF and ALT.
+ */
+std::string getCanonicalKey(const ReferenceSequence& chromosome, const std::string& chromosomeName,
+    const std::string& line) {
+  int position = atoi(getField(line, 1).c_str());
+  std::vector<std::string> alleles(1, getField(line, 3));
+  std::stringstream altStream(getField(line, 4));
+  std::string alternativeAllele;
+  while (getline(altStream, alternativeAllele, ',')) {
+    alleles.push_back(alternativeAllele);
+  }
+  for (int alleleIndex = 0; alleleIndex < alleles.size(); ++alleleIndex) {
+    for (int i = 0; i < alleles[alleleIndex].length(); ++i) {
+      alleles[alleleIndex][i] = toupper(alleles[alleleIndex][i]);
+    }
+  }
+  int originalPosition = position;
+  std::vector<std::string> originalAlleles = alleles;
+  if (position < 1 || alleles.size() < 2 || normalizeAlleles(chromosome, position, alleles) != ALIGNED) {
+    position = originalPosition;
+    alleles = originalAlleles;
+  }
+  std::stringstream key;
+  key << chromosomeName << '\t' << position;
+  for (int alleleIndex = 0; alleleIndex < alleles.size(); ++alleleIndex) {
+    key << '\t' << alleles[alleleIndex];
+  }
+  return key.str();
+}
+
+/** Computes the keys of every numberOfThreads-th record of the batch, starting at firstIndex. **/
+void computeKeys(const ReferenceSequence* chromosome, KeyBatch* batch, int firstIndex, int numberOfThreads) {
+  for (int recordIndex = firstIndex; recordIndex < batch->lines_.size(); recordIndex += numberOfThreads) {
+    batch->keys_[recordIndex] = getCanonicalKey(*chromosome, batch->chromosomeName_, batch->lines_[recordIndex]);
+  }
+}
+
+/**
+ * Computes the keys of the records of the batch (in parallel if more than one thread is used), writes the
+ * records whose key was seen before, and empties the batch.
+ */
+void processBatch(ReferenceGenome& referenceGenome, KeyBatch& batch, int numberOfThreads,
+    std::unordered_set<std::string>& seenKeys) {
+  if (batch.lines_.empty()) {
+    return;
+  }
+  const ReferenceSequence& chromosome = referenceGenome.getChromosome(batch.chromosomeName_);
+  batch.keys_.assign(batch.lines_.size(), "");
+  if (numberOfThreads == 1) {
+    computeKeys(&chromosome, &batch, 0, 1);
+  } else {
+    std::vector<std::thread> workers;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+      workers.push_back(std::thread(computeKeys, &chromosome, &batch, threadIndex, numberOfThreads));
+    }
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+      workers[threadIndex].join();
+    }
+  }
+  for (int recordIndex = 0; recordIndex < batch.lines_.size(); ++recordIndex) {
+    if (!seenKeys.insert(batch.keys_[recordIndex]).second) {
+      const std::string& line = batch.lines_[recordIndex];
+      std::cout << batch.chromosomeName_ << ":" << getField(line, 1) << ":" << getField(line, 3) << ":" <<
+        getField(line, 4) << "\n";
+    }
+  }
+  batch.lines_.clear();
+}
+
+/** Finds the records with the same canonical key as an earlier record, wherever they are in the file **/
+void findCanonicalDuplicates(const std::string& nameOfInputFile, const std::string& nameOfReference,
+    int numberOfThreads, bool useWindowedReference) {
+  std::ifstream inputFile(nameOfInputFile.c_str());
+  ReferenceGenome referenceGenome(nameOfReference, useWindowedReference);
+  std::unordered_set<std::string> seenKeys;
+  KeyBatch batch;
+  std::string line;
+  while (getline(inputFile, line)) {
+    if (line.length() == 0) {
+      break;
+    }
+    if (line[0] == '#') {
+      referenceGenome.addExpectedChromosome(getContigId(line)); // so the next chromosome can be prefetched
+      continue;
+    }
+    std::string chromosomeName = line.substr(0, line.find('\t'));
+    if (chromosomeName != batch.chromosomeName_ || batch.lines_.size() == MAXIMUM_BATCH_SIZE) {
+      processBatch(referenceGenome, batch, numberOfThreads, seenKeys);
+      batch.chromosomeName_ = chromosomeName;
+    }
+    batch.lines_.push_back(line);
+  }
+  processBatch(referenceGenome, batch, numberOfThreads, seenKeys);
+  inputFile.close();
+}
+
+
 int main(int argc, char** argv) {
   //std::cout << "Converting the input VCF to output VCF";
   if (argc < 2) { std::cout <<
@@ -104,13 +246,48 @@ int main(int argc, char** argv) {
       "\n"
       "Purpose: finds all duplicate events (same chromosome, position, ref and alt) and writes a list containing them to standard output.\n"
       "\n"
-      "usage: ./find_dup input_vcf\n"
+      "By default only adjacent duplicates are found. With -r reference, every record gets a canonical key from "
+      "the reference: its leftmost, trimmed representation (like left_align gives), so \"chr1 100 A AT\" and the "
+      "same insertion written further to the right in an A-repeat have the same key. Duplicates are then found "
+      "anywhere in the file by hashing those keys; the records themselves are not changed, and each duplicate is "
+      "written as it is in the file. -t N computes the keys with N threads, -w reads the reference page by page.\n"
+      "\n"
+      "usage: ./find_dup input_vcf [-r reference [-t number_of_threads] [-w]]\n"
       "example: ./find_dup gatk_hanchild.vcf > gatk_hanchild_duplicates.txt\n"
+      "example: ./find_dup merged_callers.vcf -r hg19.fa -t 8 > merged_callers_duplicates.txt\n"
       "\n"
       "contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
   } else {
     std::string nameOfInputFile = argv[1];
-    transformFile(nameOfInputFile);  	
+    std::string nameOfReference = "";
+    int numberOfThreads = 1;
+    bool useWindowedReference = false;
+    for (int argumentIndex = 2; argumentIndex < argc; ++argumentIndex) {
+      std::string option = argv[argumentIndex];
+      if (option == "-r" && argumentIndex + 1 < argc) {
+        nameOfReference = argv[++argumentIndex];
+      } else if (option == "-t" && argumentIndex + 1 < argc) {
+        numberOfThreads = atoi(argv[++argumentIndex]);
+        if (numberOfThreads < 1) {
+          std::cout << "find_dup error: the number of threads should be at least 1." << std::endl;
+          return -1;
+        }
+      } else if (option == "-w") {
+        useWindowedReference = true;
+      } else {
+        std::cout << "find_dup error: unknown or incomplete option " << option << std::endl;
+        return -1;
+      }
+    }
+    if (nameOfReference.empty()) {
+      if (numberOfThreads > 1 || useWindowedReference) {
+        std::cout << "find_dup error: -t and -w are only used with -r reference." << std::endl;
+        return -1;
+      }
+      transformFile(nameOfInputFile);
+    } else {
+      findCanonicalDuplicates(nameOfInputFile, nameOfReference, numberOfThreads, useWindowedReference);
+    }
   }
   return 0;
 }
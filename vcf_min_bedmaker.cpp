@@ -10,6 +10,7 @@
   reference or read can shift it greatly, or that an insertion should actually have
   a size of one, but that would not be helpful for establishing overlaps in noisy
   regions.
+  Events with a symbolic allele (like <DEL>) get their size from SVLEN (or END) in the INFO field.
 
   usage: ./min_bedmaker input_vcf output_bed
   example: ./min_bedmaker pacbio_hanchild.vcf pacbio_hanchild.bed
@@ -22,6 +23,8 @@
 #include <sstream>
 #include <string>
 
+#include "symbolic_alleles.h"
+
 /* Returns whether a string starts with a certain other string, so if
    'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
    returns true. */
@@ -85,7 +88,16 @@ void transformFile(const std::string& nameOfInputFile, const std::string& nameOf
     std::string alt;
     buffer_ss >> alt;
 
-    outputFile << chrom << "\t" << pos-1 << "\t" << pos + eventLength(ref,alt)  << std::endl;
+    int length = eventLength(ref,alt);
+    if (isSymbolicAllele(alt)) {
+      std::string info;
+      buffer_ss >> dummy >> dummy >> info; // skip QUAL and FILTER
+      int symbolicLength = getSymbolicEventSize(info, pos);
+      if (symbolicLength >= 0) {
+        length = symbolicLength;
+      }
+    }
+    outputFile << chrom << "\t" << pos-1 << "\t" << pos + length  << std::endl;
   }     
   inputFile.close();
   outputFile.close();
@@ -106,6 +118,7 @@ int main(int argc, char** argv) {
     "reference or read can shift it greatly, or that an insertion should actually have "
     "a size of one, but that would not be helpful for establishing overlaps in noisy "
     "regions.\n"
+    "Events with a symbolic allele (like <DEL>) get their size from SVLEN (or END) in the INFO field.\n"
     "\n"
     "Usage: ./min_bedmaker input_vcf output_bed\n"
     "Example: ./min_bedmaker pacbio_hanchild.vcf pacbio_hanchild.bed\n"
@@ -0,0 +1,40 @@
+/**
+ * vcf_normalize.cpp
+ *
+ * Purpose: normalizes the records of a VCF file in a single pass: expands PacBio-style <INS> and
+ * <DEL> alleles into full alleles (-e), corrects deletions written as "chr1 10 AT C" into
+ * "chr1 9 CA C" (-d), and left-aligns and trims all records (-a, also the default if no step is
+ * chosen). The steps can be combined, and are applied to each record in that order, so the
+ * reference is read and the VCF is parsed only once.
+ *
+ * Usage: ./normalize input_vcf reference_fasta output_vcf [-e] [-d] [-a] [-w] [-t number_of_threads]
+ * Example: ./normalize pacbio_hanchild.vcf hg38.fa pacbio_hanchild_normalized.vcf -e -d -a
+ *
+ * Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
+ */
+
+#include "normalization.h"
+
+int main(int argc, char** argv) {
+  const char* usage =
+    "normalize\n"
+    "\n"
+    "Purpose: normalizes the records of a VCF file in a single pass. The steps can be combined, and are "
+    "applied to each record in the order below, so the reference is read and the VCF is parsed only once.\n"
+    "\n"
+    "Usage: ./normalize input_vcf reference_fasta output_vcf [-e] [-d] [-a] [-w] [-t number_of_threads]\n"
+    "Example: ./normalize pacbio_hanchild.vcf hg38.fa pacbio_hanchild_normalized.vcf -e -d -a\n"
+    "\n"
+    "-e: expand PacBio-style symbolic alleles (T <INS> with SEQ=, T <DEL> with SVLEN=) into full alleles.\n"
+    "-d: correct deletions written as \"chr1 10 AT C\" into \"chr1 9 CA C\" (some PacBio callers).\n"
+    "-a: left-align and trim all records without symbolic alleles (the default if no step is chosen).\n"
+    "-w: read the reference page by page through its .fai index (which is created if needed) "
+    "instead of loading whole chromosomes; much faster for VCF files with few events, like gene panels.\n"
+    "-t: the number of threads that normalize the records of a chromosome (default 1); the output keeps "
+    "the order of the input.\n"
+    "\n"
+    "left_align, standardize and del_corr are normalize with -a, -e -a and -e -d -a.\n"
+    "\n"
+    "contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
+  return runNormalization("normalize", usage, NormalizationSteps(false, false, false), argc, argv);
+}
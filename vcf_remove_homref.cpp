@@ -4,7 +4,10 @@
   Purpose: from an input VCF file that has only one sample, removes all lines containing homref-
   only events (like 0/0, or ./., or .). While usually a VCF file would not have this structure,
   homref lines can come into being after creating a single sample VCF file from a multi-sample
-  vcf file, by for example using vcftools.
+  vcf file, by for example using vcftools. With several samples, a line is kept if any sample
+  has an alternative allele (0/1, 1|0, 0/12, ./2, ...); phased and unphased genotypes are treated alike.
+  Haploid genotypes are judged the same way: 0 is homref and is removed, 1 is kept. (Older versions
+  only removed genotypes starting with 0/0 or '.', so they kept haploid 0 and phased 0|0.)
 
   usage: ./remove_homref input_vcf output_vcf
   example: ./remove_homref gatk_hanchild.vcf gatk_hanchild_without_homref.vcf
@@ -12,21 +15,14 @@
   contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
+#include <algorithm> // find
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <string>
 
-/* Returns whether a string starts with a certain other string, so if
-   'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
-   returns true. */
-bool StringStartsWith(const std::string& stringToBeAssessed,
-    const std::string& putativeStart) {
-  int subStringLength = putativeStart.length();
-  std::string startOfAssessableString =
-      stringToBeAssessed.substr(0,subStringLength);
-  return (startOfAssessableString.compare(putativeStart) == 0 );
-}
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 bool isInsertion(const std::string& ref, const std::string& alt) {
   return ((ref.length() == 1) && (alt.length() > 1 ));
@@ -36,16 +32,67 @@ bool isDeletion(const std::string& ref, const std::string& alt) {
   return ((ref.length() > 1) && (alt.length() == 1 ));
 }
 
+/** Finds the first tab at or after 'position', or returns 'end'. With SSE2, 16 bytes are compared at once. **/
+const char* findNextTab(const char* position, const char* end) {
+#ifdef __SSE2__
+  const __m128i tabs = _mm_set1_epi8('\t');
+  for (; position + 16 <= end; position += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+    int tabMask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, tabs));
+    if (tabMask != 0) {
+      return position + __builtin_ctz(tabMask);
+    }
+  }
+#endif
+  while (position < end && *position != '\t') {
+    ++position;
+  }
+  return position;
+}
+
+/** Where field 'fieldIndex' (0 for CHROM) of the line starts; 'end' if the line has fewer fields **/
+const char* findField(const char* lineStart, const char* end, int fieldIndex) {
+  const char* position = lineStart;
+  for (int tabsToSkip = fieldIndex; tabsToSkip > 0 && position < end; --tabsToSkip) {
+    position = findNextTab(position, end) + 1;
+  }
+  return (position < end) ? position : end;
+}
+
+/**
+ * Whether the genotype at the start of a sample column has an alternative allele. Allele
+ * indices other than 0 always contain a digit from 1 to 9, so 0/0, 0|0, ./. and . do not,
+ * while 0/1, 1|1, 0/10 and ./2 do. The genotype ends at the first ':' or tab.
+ */
+bool hasAlternativeAllele(const char* genotype, const char* end) {
+  for (; genotype < end && *genotype != ':' && *genotype != '\t'; ++genotype) {
+    if (*genotype >= '1' && *genotype <= '9') {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Whether any sample of the line has an alternative allele; stops at the first sample that does. **/
+bool hasNonHomrefSample(const char* firstSample, const char* end) {
+  const char* sample = firstSample;
+  while (sample < end) {
+    if (hasAlternativeAllele(sample, end)) {
+      return true;
+    }
+    sample = findNextTab(sample, end) + 1;
+  }
+  return false;
+}
+
 void transformFile(const std::string& nameOfInputFile, const std::string& nameOfOutputFile) {
   std::ifstream inputFile(nameOfInputFile.c_str());
   std::ofstream outputFile(nameOfOutputFile.c_str());
 
   std::string oldChrom = "";
-  std::string oldPos = "";
+  std::string line;
 
   while (!inputFile.eof()) {
-    std::string line;
-    std::stringstream buffer_ss;
     getline(inputFile, line );
     if (line.length() == 0) {
       break;
@@ -58,49 +105,25 @@ void transformFile(const std::string& nameOfInputFile, const std::string& nameOf
       continue;
     }
 
-    buffer_ss << line;
-    std::string dummy;
-    std::string chrom;
-    std::string pos;
-
-    buffer_ss >> chrom;
-    buffer_ss >> pos;
- 
-    if (chrom != oldChrom) {
-      std::cout << "Chromosome: " << chrom << std::endl;
-    }
-    
-    oldChrom = chrom;
-    oldPos = pos;
-
-    for (int i = 0; i < 1; i++ ) {
-       buffer_ss >> dummy;
+    // the fields are located in place; only the chromosome name is copied, and only when it changes
+    const char* lineStart = line.data();
+    const char* lineEnd = lineStart + line.length();
+    const char* chromEnd = findNextTab(lineStart, lineEnd);
+    if (oldChrom.compare(0, std::string::npos, lineStart, chromEnd - lineStart) != 0) {
+      oldChrom.assign(lineStart, chromEnd);
+      std::cout << "Chromosome: " << oldChrom << std::endl;
     }
-    std::string ref;
-    buffer_ss >> ref;
-    std::string alt;
-    buffer_ss >> alt;
 
-    if (alt.find_first_of(',') != std::string::npos) {
-      std::cout << "Ref: " << ref << " alt " << alt << "\n";
+    const char* ref = findField(lineStart, lineEnd, 3);
+    const char* alt = findField(lineStart, lineEnd, 4);
+    const char* altEnd = findNextTab(alt, lineEnd);
+    if (std::find(alt, altEnd, ',') != altEnd) {
+      std::cout << "Ref: " << std::string(ref, findNextTab(ref, lineEnd)) << " alt " << std::string(alt, altEnd) << "\n";
       continue;
     }
-    for (int i = 0; i < 4; i++ ) {
-       buffer_ss >> dummy;
-    }
 
-    bool isValidLine = false;
-    while (buffer_ss) {
-      std::string genotype;
-      buffer_ss >> genotype;
-      if (genotype.length() == 0) {
-        break;
-      }
-    
-      if (!(StringStartsWith(genotype,"0/0") || StringStartsWith(genotype,"."))) {
-        isValidLine = true;
-      }
-    }
+    const char* firstSample = findField(altEnd, lineEnd, 5); // skip QUAL, FILTER, INFO and FORMAT
+    bool isValidLine = hasNonHomrefSample(firstSample, lineEnd);
     if (isValidLine) {
       outputFile << line << "\n";
     } else {
@@ -121,7 +144,10 @@ int main(int argc, char** argv) {
       "Purpose: from an input VCF file that has only one sample, removes all lines containing homref-"
       "only events (like 0/0, or ./., or .). While usually a VCF file would not have this structure, "
       "homref lines can come into being after creating a single sample VCF file from a multi-sample "
-      "VCF file, for example by using vcftools.\n"
+      "VCF file, for example by using vcftools. With several samples, a line is kept if any sample has an "
+      "alternative allele (0/1, 1|0, 0/12, ./2, ...); phased and unphased genotypes are treated alike. "
+      "Haploid genotypes are judged the same way: 0 is homref and is removed, 1 is kept. (Older versions "
+      "only removed genotypes starting with 0/0 or '.', so they kept haploid 0 and phased 0|0.)\n"
       "\n"
       "usage: ./remove_homref input_vcf output_vcf\n"
       "example: ./remove_homref gatk_hanchild.vcf gatk_hanchild_without_homref.vcf\n"
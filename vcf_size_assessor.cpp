@@ -9,21 +9,33 @@
   2       36753   Pindel  deletion
   3       14359   Pindel  deletion
   ...     ...     ...     ... 
+  2000-3999  12   Pindel  deletion
 
-  Note that it should only be used on a file that contains only one type
-  of event (insertion or deletion)
+  The size of an event is the difference in length between ref and alt (so 0 for SNPs). Events with
+  a symbolic allele (like <DEL>) get their size from SVLEN (or END) in the INFO field. Sizes below
+  1000 (or the limit given with -l) are counted one by one; larger sizes in bins that double in width.
+  If the SV type is given, all events are counted together under that name, so the file should
+  contain only one type of event (insertion or deletion). Without it, each event is classified (INS,
+  DEL, SNP or RPL, as compare does), and every type gets its own rows, so a mixed file needs no
+  indel_split first. With -t N, N threads each count part of the file.
 
-  Usage: ./size_ass input_vcf output_txt name_of_caller name_of_sv_type
+  Usage: ./size_ass input_vcf output_txt name_of_caller [name_of_sv_type] [-t number_of_threads] [-l limit]
   Example: ./size_ass pindel_hanchild_del.vcf pindel_hanchild_del_sizes.txt Pindel deletion
+  Example: ./size_ass pindel_hanchild.vcf pindel_hanchild_sizes.txt Pindel -t 4
 
   Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
-#include <map>
-#include <sstream>
 #include <string>
+#include <vector>
+
+#include "chunked_input.h"
+#include "event_type.h"
+#include "size_histogram.h"
+#include "symbolic_alleles.h"
 
 /* Returns whether a string starts with a certain other string, so if
    'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
@@ -54,72 +66,95 @@ int getEventSize(const std::string& ref, const std::string& alt) {
   return eventSize;
 }
 
-void transformFile(const std::string& nameOfInputFile, const std::string& nameOfOutputFile,
-  const std::string& nameOfCaller, const std::string& nameOfSvType) {
-  std::ifstream inputFile(nameOfInputFile.c_str());
-  std::ofstream outputFile(nameOfOutputFile.c_str());
-
-  std::string oldChrom = "";
-  std::string oldPos = "";
-
-  std::map<int,int> sizeCounts;
+/**
+ * Counts the sizes of the events among the lines that one thread reads: in one histogram per event
+ * type, or, if the type was given on the command line, in a single histogram.
+ */
+class SizeCounter : public LineHandler {
+public:
+  SizeCounter(bool separateTypes, int exactLimit) : separateTypes_(separateTypes),
+      histograms_(NUMBER_OF_EVENT_CLASSES, SizeHistogram(exactLimit)), numberOfMultiAltRecords_(0),
+      numberOfUnknownSizes_(0) {
+  }
 
-  while (!inputFile.eof()) {
-    std::string line;
-    std::stringstream buffer_ss;
-    getline(inputFile, line );
-    if (line.length() == 0) {
-      break;
+  void handleLine(const char* start, const char* end) {
+    if (start == end || *start == '#') {
+      return;
+    }
+    const char* fieldStarts[8];
+    const char* fieldEnds[8];
+    splitFields(start, end, 8, fieldStarts, fieldEnds);
+    ref_.assign(fieldStarts[3], fieldEnds[3]);
+    alt_.assign(fieldStarts[4], fieldEnds[4]);
+    if (alt_.find_first_of(',') != std::string::npos) {
+      ++numberOfMultiAltRecords_;
+      return;
+    }
+    int size = getEventSize(ref_, alt_);
+    if (isSymbolicAllele(alt_)) {
+      size = getSymbolicEventSize(std::string(fieldStarts[7], fieldEnds[7]), atoi(fieldStarts[1]));
+      if (size < 0) {
+        ++numberOfUnknownSizes_;
+        return;
+      }
     }
+    histograms_[separateTypes_ ? classifyEvent(ref_, alt_) : 0].add(size);
+  }
 
-    // skip lines beginning with '#'
-    const char START_OF_COMMENT_CHAR = '#';
-    if (line[0] == START_OF_COMMENT_CHAR ) {
-      continue;
+  void merge(const SizeCounter& otherCounter) {
+    for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+      histograms_[eventClass].merge(otherCounter.histograms_[eventClass]);
     }
+    numberOfMultiAltRecords_ += otherCounter.numberOfMultiAltRecords_;
+    numberOfUnknownSizes_ += otherCounter.numberOfUnknownSizes_;
+  }
 
-    buffer_ss << line;
-    std::string dummy;
-    std::string chrom;
-    std::string pos;
+  bool separateTypes_;
+  std::vector<SizeHistogram> histograms_; // per EventClass, or only the first
+  long long numberOfMultiAltRecords_;
+  long long numberOfUnknownSizes_;
 
-    buffer_ss >> chrom;
-    buffer_ss >> pos;
- 
-    if (chrom != oldChrom) {
-      std::cout << "Chromosome: " << chrom << std::endl;
-    }
-    
-    if (chrom == oldChrom && pos == oldPos) {
-       std::cout << chrom << ":" << pos << std::endl;
-    }
-    oldChrom = chrom;
+private:
+  std::string ref_;
+  std::string alt_;
+};
 
-    for (int i = 0; i < 1; i++ ) {
-       buffer_ss >> dummy;
-    }
-    std::string ref;
-    buffer_ss >> ref;
-    std::string alt;
-    buffer_ss >> alt;
-
-    if (alt.find_first_of(',') != std::string::npos) {
-      std::cout << "Ref: " << ref << " alt " << alt << "\n";
-      continue;
-    }
-    
-    int size = getEventSize(ref,alt);
-    std::cout << "Size: " << size << ", mapsize: " << sizeCounts.size() << std::endl;
-    if (sizeCounts.count(size) == 0 ) {
-      sizeCounts[size] = 1;
-    } else {
-      ++sizeCounts[size];
+void transformFile(const std::string& nameOfInputFile, const std::string& nameOfOutputFile,
+    const std::string& nameOfCaller, const std::string& nameOfSvType, int numberOfThreads, int exactLimit) {
+  ChunkedInput input(nameOfInputFile);
+  bool separateTypes = nameOfSvType.empty();
+  std::vector<SizeCounter> counters(numberOfThreads, SizeCounter(separateTypes, exactLimit));
+  std::vector<LineHandler*> handlers;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+    handlers.push_back(&counters[threadIndex]);
+  }
+  readLinesInParallel(input, handlers);
+  SizeCounter& sizeCounts = counters[0];
+  for (int threadIndex = 1; threadIndex < numberOfThreads; ++threadIndex) {
+    sizeCounts.merge(counters[threadIndex]);
+  }
+  if (sizeCounts.numberOfMultiAltRecords_ > 0) {
+    std::cout << "Skipped " << sizeCounts.numberOfMultiAltRecords_ << " records with multiple alt alleles.\n";
+  }
+  if (sizeCounts.numberOfUnknownSizes_ > 0) {
+    std::cout << "Skipped " << sizeCounts.numberOfUnknownSizes_ << " symbolic events of unknown size.\n";
+  }
+
+  std::ofstream outputFile(nameOfOutputFile.c_str());
+  outputFile << "Size\tCount\tCaller\tSvType\n";
+  for (int eventClass = 0; eventClass < (separateTypes ? NUMBER_OF_EVENT_CLASSES : 1); ++eventClass) {
+    const SizeHistogram& histogram = sizeCounts.histograms_[eventClass];
+    std::string svType = separateTypes ? getEventClassName(static_cast<EventClass>(eventClass)) : nameOfSvType;
+    for (int binIndex = 0; binIndex < histogram.getNumberOfBins(); ++binIndex) {
+      if (histogram.getBinCount(binIndex) == 0) {
+        continue;
+      }
+      outputFile << histogram.getBinStart(binIndex);
+      if (histogram.getBinEnd(binIndex) != histogram.getBinStart(binIndex)) {
+        outputFile << "-" << histogram.getBinEnd(binIndex);
+      }
+      outputFile << "\t" << histogram.getBinCount(binIndex) << "\t" << nameOfCaller << "\t" << svType << "\n";
     }
-  }     
-  inputFile.close();
-  outputFile << "Size\tCount\tCaller\tSvType" << std::endl;
-  for (std::map<int,int>::iterator it = sizeCounts.begin(); it != sizeCounts.end(); ++it) {
-    outputFile << it->first << "\t" << it->second << "\t" << nameOfCaller << "\t" << nameOfSvType << std::endl;
   }
   outputFile.close();
 }
@@ -138,26 +173,59 @@ int main(int argc, char** argv) {
       "2       36753   Pindel  deletion\n"
       "3       14359   Pindel  deletion\n"
       "...     ...     ...     ...\n"
+      "2000-3999  12   Pindel  deletion\n"
       "\n"
-      "Note that it should only be used on a file that contains only one type "
-      "of event (insertion or deletion).\n"
+      "The size of an event is the difference in length between ref and alt (so 0 for SNPs). Events with "
+      "a symbolic allele (like <DEL>) get their size from SVLEN (or END) in the INFO field. Sizes below "
+      "1000 (or the limit given with -l) are counted one by one; larger sizes in bins that double in width. "
+      "If the SV type is given, all events are counted together under that name, so the file should "
+      "contain only one type of event (insertion or deletion). Without it, each event is classified (INS, "
+      "DEL, SNP or RPL, as compare does), and every type gets its own rows, so a mixed file needs no "
+      "indel_split first. With -t N, N threads each count part of the file.\n"
       "\n"
-      "Usage: ./size_ass input_vcf output_txt name_of_caller name_of_sv_type\n"
+      "Usage: ./size_ass input_vcf output_txt name_of_caller [name_of_sv_type] [-t number_of_threads] [-l limit]\n"
       "Example: ./size_ass pindel_hanchild_del.vcf pindel_hanchild_del_sizes.txt Pindel deletion\n"
+      "Example: ./size_ass pindel_hanchild.vcf pindel_hanchild_sizes.txt Pindel -t 4\n"
       "\n"
       "Contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
     return -1;
-  } else if (argc < 5) {
-    std::cout << "Invalid number of arguments. At least four arguments "
+  } else if (argc < 4) {
+    std::cout << "Invalid number of arguments. At least three arguments "
         "are needed, the name of the input file and the name of the "
-        "output file, the name of the caller and the name of the SV type (like deletion).";
+        "output file, and the name of the caller; optionally followed by the name of the SV type (like deletion).";
     return -1;
   } else {
     std::string nameOfInputFile = argv[1];
     std::string nameOfOutputFile = argv[2];
     std::string nameOfCaller = argv[3];
-    std::string nameOfSvType = argv[4];
-    transformFile(nameOfInputFile, nameOfOutputFile, nameOfCaller, nameOfSvType);
+    int argumentIndex = 4;
+    std::string nameOfSvType = "";
+    if (argc > 4 && argv[4][0] != '-') {
+      nameOfSvType = argv[4];
+      ++argumentIndex;
+    }
+    int numberOfThreads = 1;
+    int exactLimit = 1000;
+    for (; argumentIndex < argc; ++argumentIndex) {
+      std::string option = argv[argumentIndex];
+      if (option == "-t" && argumentIndex + 1 < argc) {
+        numberOfThreads = atoi(argv[++argumentIndex]);
+        if (numberOfThreads < 1) {
+          std::cout << "size_ass error: the number of threads should be at least 1." << std::endl;
+          return -1;
+        }
+      } else if (option == "-l" && argumentIndex + 1 < argc) {
+        exactLimit = atoi(argv[++argumentIndex]);
+        if (exactLimit < 1) {
+          std::cout << "size_ass error: the limit should be at least 1." << std::endl;
+          return -1;
+        }
+      } else {
+        std::cout << "size_ass error: unknown or incomplete option " << option << std::endl;
+        return -1;
+      }
+    }
+    transformFile(nameOfInputFile, nameOfOutputFile, nameOfCaller, nameOfSvType, numberOfThreads, exactLimit);
 
     return 0;
   }
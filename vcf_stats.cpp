@@ -0,0 +1,440 @@
+/**
+  vcf_stats.cpp
+
+  Purpose: computes the statistics that are otherwise collected with count_events, size_ass and find_mlma,
+  in one pass over a VCF file (plain, bgzipped or gzipped): the number of records, per chromosome and per
+  event type (SNP, INS, DEL, RPL, classified per ALT allele as compare does; the ALT alleles '*' and '.'
+  are skipped), the transition/transversion ratio of the SNPs between A, C, G and T, histograms of the
+  sizes of insertions and deletions (exact up to 63 bases, then in bins that double in width), the number
+  of multi-allelic records and of records at the same position as the previous record (multi-line
+  multi-alt events, as find_mlma reports them), and per sample the number of hom-ref, het, hom-alt and
+  missing genotypes. With -t N, N threads each read part of the file. The output is a TSV file in which
+  the first column names the statistic, or with -j a JSON file.
+
+  usage: ./stats input_vcf output_file [-t number_of_threads] [-j]
+  example: ./stats gatk_hanchild.vcf gatk_hanchild_stats.tsv
+  example: ./stats gatk_hanchild.vcf.gz gatk_hanchild_stats.json -t 8 -j
+
+  contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
+**/
+
+#include <cctype> // toupper
+#include <cstdlib> // atoi
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chunked_input.h"
+#include "event_type.h"
+#include "genotypes.h"
+#include "size_histogram.h"
+#include "symbolic_alleles.h"
+
+enum GenotypeClass { HOM_REF, HET, HOM_ALT, NO_CALL };
+
+const int NUMBER_OF_GENOTYPE_CLASSES = 4;
+
+/** Whether a base is A, C, G or T (in upper or lower case); only SNPs between such bases are Ts or Tv **/
+bool isAcgt(char base) {
+  char upperCaseBase = toupper(base);
+  return upperCaseBase == 'A' || upperCaseBase == 'C' || upperCaseBase == 'G' || upperCaseBase == 'T';
+}
+
+/** Whether an SNP between two different ACGT bases is a transition (A<->G, C<->T) rather than a transversion **/
+bool isTransition(char referenceBase, char alternativeBase) {
+  bool isReferencePurine = (toupper(referenceBase) == 'A' || toupper(referenceBase) == 'G');
+  bool isAlternativePurine = (toupper(alternativeBase) == 'A' || toupper(alternativeBase) == 'G');
+  return isReferencePurine == isAlternativePurine;
+}
+
+/**
+ * 'StatisticsAccumulator' gathers the statistics of the lines that one thread reads. The accumulators
+ * of all threads are merged afterwards; as each thread reads a later part of the file than the previous
+ * one, the first and last locus of each accumulator suffice to find the repeated loci at the borders.
+ */
+class StatisticsAccumulator : public LineHandler {
+public:
+  StatisticsAccumulator() : numberOfMultiallelicRecords_(0), numberOfRepeatedLoci_(0), numberOfTransitions_(0),
+      numberOfTransversions_(0), currentCounts_(NULL) {
+  }
+
+  void handleLine(const char* start, const char* end) {
+    if (start == end) {
+      return;
+    }
+    if (*start == '#') {
+      if (end - start > 6 && std::string(start, 6) == "#CHROM") {
+        readSampleNames(start, end);
+      }
+      return;
+    }
+    const char* fieldStarts[10];
+    const char* fieldEnds[10];
+    splitFields(start, end, 10, fieldStarts, fieldEnds);
+
+    locus_.assign(start, fieldEnds[1]);
+    if (firstLocus_.empty()) {
+      firstLocus_ = locus_;
+    } else if (locus_ == lastLocus_) {
+      ++numberOfRepeatedLoci_;
+    }
+    lastLocus_.swap(locus_);
+
+    if (currentCounts_ == NULL || chromosomeName_.compare(0, std::string::npos, start, fieldEnds[0] - start) != 0) {
+      // VCF files are normally sorted, so the chromosome is mostly that of the previous line
+      chromosomeName_.assign(start, fieldEnds[0]);
+      std::map<std::string, EventCounts>::iterator countsIt = contigCounts_.find(chromosomeName_);
+      if (countsIt == contigCounts_.end()) {
+        chromosomeOrder_.push_back(chromosomeName_);
+        countsIt = contigCounts_.insert(std::make_pair(chromosomeName_, EventCounts())).first;
+      }
+      currentCounts_ = &countsIt->second;
+    }
+    ++currentCounts_->numberOfRecords_;
+
+    referenceAllele_.assign(fieldStarts[3], fieldEnds[3]);
+    const char* alleleStart = fieldStarts[4];
+    bool isMultiallelic = false;
+    for (const char* alleleEnd = alleleStart; alleleEnd <= fieldEnds[4]; ++alleleEnd) {
+      if (alleleEnd == fieldEnds[4] || *alleleEnd == ',') {
+        alternativeAllele_.assign(alleleStart, alleleEnd);
+        addAllele(fieldStarts, fieldEnds);
+        isMultiallelic = isMultiallelic || (alleleEnd != fieldEnds[4]);
+        alleleStart = alleleEnd + 1;
+      }
+    }
+    numberOfMultiallelicRecords_ += isMultiallelic;
+
+    if (fieldEnds[8] - fieldStarts[8] >= 2 && fieldStarts[8][0] == 'G' && fieldStarts[8][1] == 'T' &&
+        (fieldEnds[8] - fieldStarts[8] == 2 || fieldStarts[8][2] == ':')) {
+      addGenotypes(fieldStarts[9], end);
+    }
+  }
+
+  void merge(const StatisticsAccumulator& otherAccumulator) {
+    if (!otherAccumulator.firstLocus_.empty()) {
+      if (!lastLocus_.empty() && otherAccumulator.firstLocus_ == lastLocus_) {
+        ++numberOfRepeatedLoci_;
+      }
+      if (firstLocus_.empty()) {
+        firstLocus_ = otherAccumulator.firstLocus_;
+      }
+      lastLocus_ = otherAccumulator.lastLocus_;
+    }
+    if (sampleNames_.empty()) {
+      sampleNames_ = otherAccumulator.sampleNames_;
+    }
+    for (int i = 0; i < otherAccumulator.chromosomeOrder_.size(); ++i) {
+      const std::string& chromosomeName = otherAccumulator.chromosomeOrder_[i];
+      if (contigCounts_.find(chromosomeName) == contigCounts_.end()) {
+        chromosomeOrder_.push_back(chromosomeName);
+      }
+      contigCounts_[chromosomeName].add(otherAccumulator.contigCounts_.find(chromosomeName)->second);
+    }
+    numberOfMultiallelicRecords_ += otherAccumulator.numberOfMultiallelicRecords_;
+    numberOfRepeatedLoci_ += otherAccumulator.numberOfRepeatedLoci_;
+    numberOfTransitions_ += otherAccumulator.numberOfTransitions_;
+    numberOfTransversions_ += otherAccumulator.numberOfTransversions_;
+    insertionSizes_.merge(otherAccumulator.insertionSizes_);
+    deletionSizes_.merge(otherAccumulator.deletionSizes_);
+    if (otherAccumulator.genotypeCounts_.size() > genotypeCounts_.size()) {
+      genotypeCounts_.resize(otherAccumulator.genotypeCounts_.size(),
+        std::vector<long long>(NUMBER_OF_GENOTYPE_CLASSES, 0));
+    }
+    for (int sampleIndex = 0; sampleIndex < otherAccumulator.genotypeCounts_.size(); ++sampleIndex) {
+      for (int genotypeClass = 0; genotypeClass < NUMBER_OF_GENOTYPE_CLASSES; ++genotypeClass) {
+        genotypeCounts_[sampleIndex][genotypeClass] += otherAccumulator.genotypeCounts_[sampleIndex][genotypeClass];
+      }
+    }
+  }
+
+  std::vector<std::string> sampleNames_;
+  std::vector<std::string> chromosomeOrder_; // in the order of the file
+  std::map<std::string, EventCounts> contigCounts_;
+  long long numberOfMultiallelicRecords_;
+  long long numberOfRepeatedLoci_;
+  long long numberOfTransitions_;
+  long long numberOfTransversions_;
+  SizeHistogram insertionSizes_;
+  SizeHistogram deletionSizes_;
+  std::vector<std::vector<long long> > genotypeCounts_; // per sample, per GenotypeClass
+
+private:
+  void readSampleNames(const char* start, const char* end) {
+    std::stringstream headerStream(std::string(start, end));
+    std::string columnName;
+    for (int columnIndex = 0; getline(headerStream, columnName, '\t'); ++columnIndex) {
+      if (columnIndex >= 9) {
+        sampleNames_.push_back(columnName);
+      }
+    }
+  }
+
+  void addAllele(const char* fieldStarts[], const char* fieldEnds[]) {
+    if (alternativeAllele_ == "*" || alternativeAllele_ == ".") {
+      return; // a deletion that spans this position, or no ALT allele at all
+    }
+    EventClass eventClass = classifyEvent(referenceAllele_, alternativeAllele_);
+    ++currentCounts_->numberPerClass_[eventClass];
+    if (eventClass == SNP_CLASS) {
+      char referenceBase = referenceAllele_[0];
+      char alternativeBase = alternativeAllele_[0];
+      if (isAcgt(referenceBase) && isAcgt(alternativeBase) && toupper(referenceBase) != toupper(alternativeBase)) {
+        ++(isTransition(referenceBase, alternativeBase) ? numberOfTransitions_ : numberOfTransversions_);
+      }
+    } else if (eventClass == INSERTION_CLASS || eventClass == DELETION_CLASS) {
+      long long size = static_cast<long long>(referenceAllele_.length()) - alternativeAllele_.length();
+      if (isSymbolicAllele(alternativeAllele_)) {
+        size = getSymbolicEventSize(std::string(fieldStarts[7], fieldEnds[7]), atoi(fieldStarts[1]));
+        if (size < 0) {
+          return; // unknown size
+        }
+      }
+      (eventClass == INSERTION_CLASS ? insertionSizes_ : deletionSizes_).add(size < 0 ? -size : size);
+    }
+  }
+
+  void addGenotypes(const char* firstSample, const char* end) {
+    genotypes_.parse(firstSample, end);
+    int numberOfSamples = genotypes_.numberOfSamples();
+    if (numberOfSamples > genotypeCounts_.size()) {
+      genotypeCounts_.resize(numberOfSamples, std::vector<long long>(NUMBER_OF_GENOTYPE_CLASSES, 0));
+    }
+    for (int groupIndex = 0; groupIndex < genotypes_.numberOfSampleGroups(); ++groupIndex) {
+      PackedGenotypes::Word samplesPerClass[NUMBER_OF_GENOTYPE_CLASSES];
+      genotypes_.classifySampleGroup(groupIndex, samplesPerClass[HOM_REF], samplesPerClass[HET],
+        samplesPerClass[HOM_ALT], samplesPerClass[NO_CALL]);
+      for (int genotypeClass = 0; genotypeClass < NUMBER_OF_GENOTYPE_CLASSES; ++genotypeClass) {
+        for (PackedGenotypes::Word samples = samplesPerClass[genotypeClass]; samples != 0; samples &= samples - 1) {
+          ++genotypeCounts_[groupIndex * PackedGenotypes::SAMPLES_PER_WORD + __builtin_ctzll(samples)][genotypeClass];
+        }
+      }
+    }
+  }
+
+  std::string firstLocus_; // "CHROM\tPOS" of the first and last record
+  std::string lastLocus_;
+  EventCounts* currentCounts_; // those of chromosomeName_
+  std::string chromosomeName_;
+  std::string locus_;
+  std::string referenceAllele_;
+  std::string alternativeAllele_;
+  PackedGenotypes genotypes_;
+};
+
+/** Writes numerator / denominator, or NA (TSV) or null (JSON) if the denominator is 0 **/
+std::string formatRatio(long long numerator, long long denominator, bool asJson) {
+  if (denominator == 0) {
+    return asJson ? "null" : "NA";
+  }
+  std::stringstream ss;
+  ss << static_cast<double>(numerator) / denominator;
+  return ss.str();
+}
+
+std::string getSampleName(const StatisticsAccumulator& statistics, int sampleIndex) {
+  if (sampleIndex < statistics.sampleNames_.size()) {
+    return statistics.sampleNames_[sampleIndex];
+  }
+  std::stringstream ss;
+  ss << "sample" << sampleIndex + 1;
+  return ss.str();
+}
+
+std::string quote(const std::string& text) {
+  std::string quotedText = "\"";
+  for (int i = 0; i < text.length(); ++i) {
+    if (text[i] == '"' || text[i] == '\\') {
+      quotedText += '\\';
+    }
+    quotedText += text[i];
+  }
+  return quotedText + "\"";
+}
+
+const char* const GENOTYPE_CLASS_NAMES[NUMBER_OF_GENOTYPE_CLASSES] = { "hom_ref", "het", "hom_alt", "no_call" };
+
+void writeTsv(const StatisticsAccumulator& statistics, const EventCounts& totalCounts, std::ofstream& outputFile) {
+  outputFile << "#statistic\tname\tvalues\n";
+  outputFile << "records\ttotal\t" << totalCounts.numberOfRecords_ << "\n";
+  outputFile << "records\tmultiallelic\t" << statistics.numberOfMultiallelicRecords_ << "\n";
+  outputFile << "records\trepeated_locus\t" << statistics.numberOfRepeatedLoci_ << "\n";
+  for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+    outputFile << "alleles\t" << getEventClassName(static_cast<EventClass>(eventClass)) << "\t" <<
+      totalCounts.numberPerClass_[eventClass] << "\n";
+  }
+  outputFile << "snps\ttransitions\t" << statistics.numberOfTransitions_ << "\n";
+  outputFile << "snps\ttransversions\t" << statistics.numberOfTransversions_ << "\n";
+  outputFile << "snps\tts_tv\t" << formatRatio(statistics.numberOfTransitions_, statistics.numberOfTransversions_,
+    false) << "\n";
+  outputFile << "#contig\tname\trecords";
+  for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+    outputFile << "\t" << getEventClassName(static_cast<EventClass>(eventClass));
+  }
+  outputFile << "\n";
+  for (int i = 0; i < statistics.chromosomeOrder_.size(); ++i) {
+    const EventCounts& counts = statistics.contigCounts_.find(statistics.chromosomeOrder_[i])->second;
+    outputFile << "contig\t" << statistics.chromosomeOrder_[i] << "\t" << counts.numberOfRecords_;
+    for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+      outputFile << "\t" << counts.numberPerClass_[eventClass];
+    }
+    outputFile << "\n";
+  }
+  outputFile << "#size\ttype\tsmallest\tlargest\tcount\n";
+  const SizeHistogram* histograms[2] = { &statistics.insertionSizes_, &statistics.deletionSizes_ };
+  for (int histogramIndex = 0; histogramIndex < 2; ++histogramIndex) {
+    const SizeHistogram& histogram = *histograms[histogramIndex];
+    for (int binIndex = 0; binIndex < histogram.getNumberOfBins(); ++binIndex) {
+      if (histogram.getBinCount(binIndex) > 0) {
+        outputFile << "size\t" << (histogramIndex == 0 ? "INS" : "DEL") << "\t" << histogram.getBinStart(binIndex) <<
+          "\t" << histogram.getBinEnd(binIndex) << "\t" << histogram.getBinCount(binIndex) << "\n";
+      }
+    }
+  }
+  outputFile << "#sample\tname";
+  for (int genotypeClass = 0; genotypeClass < NUMBER_OF_GENOTYPE_CLASSES; ++genotypeClass) {
+    outputFile << "\t" << GENOTYPE_CLASS_NAMES[genotypeClass];
+  }
+  outputFile << "\thet_hom_ratio\n";
+  for (int sampleIndex = 0; sampleIndex < statistics.genotypeCounts_.size(); ++sampleIndex) {
+    const std::vector<long long>& counts = statistics.genotypeCounts_[sampleIndex];
+    outputFile << "sample\t" << getSampleName(statistics, sampleIndex);
+    for (int genotypeClass = 0; genotypeClass < NUMBER_OF_GENOTYPE_CLASSES; ++genotypeClass) {
+      outputFile << "\t" << counts[genotypeClass];
+    }
+    outputFile << "\t" << formatRatio(counts[HET], counts[HOM_ALT], false) << "\n";
+  }
+}
+
+void writeJson(const StatisticsAccumulator& statistics, const EventCounts& totalCounts, std::ofstream& outputFile) {
+  outputFile << "{\n";
+  outputFile << "  \"records\": " << totalCounts.numberOfRecords_ << ",\n";
+  outputFile << "  \"multiallelic_records\": " << statistics.numberOfMultiallelicRecords_ << ",\n";
+  outputFile << "  \"repeated_locus_records\": " << statistics.numberOfRepeatedLoci_ << ",\n";
+  outputFile << "  \"alleles\": {";
+  for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+    outputFile << (eventClass > 0 ? ", " : "") << "\"" << getEventClassName(static_cast<EventClass>(eventClass)) <<
+      "\": " << totalCounts.numberPerClass_[eventClass];
+  }
+  outputFile << "},\n";
+  outputFile << "  \"transitions\": " << statistics.numberOfTransitions_ << ",\n";
+  outputFile << "  \"transversions\": " << statistics.numberOfTransversions_ << ",\n";
+  outputFile << "  \"ts_tv\": " << formatRatio(statistics.numberOfTransitions_, statistics.numberOfTransversions_,
+    true) << ",\n";
+  outputFile << "  \"contigs\": [";
+  for (int i = 0; i < statistics.chromosomeOrder_.size(); ++i) {
+    const EventCounts& counts = statistics.contigCounts_.find(statistics.chromosomeOrder_[i])->second;
+    outputFile << (i > 0 ? "," : "") << "\n    {\"name\": " << quote(statistics.chromosomeOrder_[i]) <<
+      ", \"records\": " << counts.numberOfRecords_;
+    for (int eventClass = 0; eventClass < NUMBER_OF_EVENT_CLASSES; ++eventClass) {
+      outputFile << ", \"" << getEventClassName(static_cast<EventClass>(eventClass)) << "\": " <<
+        counts.numberPerClass_[eventClass];
+    }
+    outputFile << "}";
+  }
+  outputFile << "\n  ],\n";
+  outputFile << "  \"sizes\": {";
+  const SizeHistogram* histograms[2] = { &statistics.insertionSizes_, &statistics.deletionSizes_ };
+  for (int histogramIndex = 0; histogramIndex < 2; ++histogramIndex) {
+    const SizeHistogram& histogram = *histograms[histogramIndex];
+    outputFile << (histogramIndex > 0 ? "," : "") << "\n    \"" << (histogramIndex == 0 ? "INS" : "DEL") << "\": [";
+    bool isFirstBin = true;
+    for (int binIndex = 0; binIndex < histogram.getNumberOfBins(); ++binIndex) {
+      if (histogram.getBinCount(binIndex) > 0) {
+        outputFile << (isFirstBin ? "" : ", ") << "{\"smallest\": " << histogram.getBinStart(binIndex) <<
+          ", \"largest\": " << histogram.getBinEnd(binIndex) << ", \"count\": " << histogram.getBinCount(binIndex) <<
+          "}";
+        isFirstBin = false;
+      }
+    }
+    outputFile << "]";
+  }
+  outputFile << "\n  },\n";
+  outputFile << "  \"samples\": [";
+  for (int sampleIndex = 0; sampleIndex < statistics.genotypeCounts_.size(); ++sampleIndex) {
+    const std::vector<long long>& counts = statistics.genotypeCounts_[sampleIndex];
+    outputFile << (sampleIndex > 0 ? "," : "") << "\n    {\"name\": " << quote(getSampleName(statistics,
+      sampleIndex));
+    for (int genotypeClass = 0; genotypeClass < NUMBER_OF_GENOTYPE_CLASSES; ++genotypeClass) {
+      outputFile << ", \"" << GENOTYPE_CLASS_NAMES[genotypeClass] << "\": " << counts[genotypeClass];
+    }
+    outputFile << ", \"het_hom_ratio\": " << formatRatio(counts[HET], counts[HOM_ALT], true) << "}";
+  }
+  outputFile << "\n  ]\n}\n";
+}
+
+void computeStatistics(const std::string& nameOfInputFile, const std::string& nameOfOutputFile, int numberOfThreads,
+    bool asJson) {
+  ChunkedInput input(nameOfInputFile);
+  std::vector<StatisticsAccumulator> accumulators(numberOfThreads);
+  std::vector<LineHandler*> handlers;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex) {
+    handlers.push_back(&accumulators[threadIndex]);
+  }
+  readLinesInParallel(input, handlers);
+
+  StatisticsAccumulator& statistics = accumulators[0];
+  for (int threadIndex = 1; threadIndex < numberOfThreads; ++threadIndex) {
+    statistics.merge(accumulators[threadIndex]);
+  }
+  EventCounts totalCounts;
+  for (int i = 0; i < statistics.chromosomeOrder_.size(); ++i) {
+    totalCounts.add(statistics.contigCounts_[statistics.chromosomeOrder_[i]]);
+  }
+
+  std::ofstream outputFile(nameOfOutputFile.c_str());
+  if (asJson) {
+    writeJson(statistics, totalCounts, outputFile);
+  } else {
+    writeTsv(statistics, totalCounts, outputFile);
+  }
+  outputFile.close();
+}
+
+
+int main(int argc, char** argv) {
+  if (argc < 3) { std::cout <<
+    "stats\n"
+    "\n"
+    "Purpose: computes the statistics that are otherwise collected with count_events, size_ass and find_mlma, "
+    "in one pass over a VCF file (plain, bgzipped or gzipped): the number of records, per chromosome and per "
+    "event type (SNP, INS, DEL, RPL, classified per ALT allele as compare does; the ALT alleles '*' and '.' "
+    "are skipped), the transition/transversion ratio of the SNPs between A, C, G and T, histograms of the "
+    "sizes of insertions and deletions (exact up to 63 bases, then in bins that double in width), the number "
+    "of multi-allelic records and of records at the same position as the previous record (multi-line "
+    "multi-alt events, as find_mlma reports them), and per sample the number of hom-ref, het, hom-alt and "
+    "missing genotypes. With -t N, N threads each read part of the file. The output is a TSV file in which "
+    "the first column names the statistic, or with -j a JSON file.\n"
+    "\n"
+    "usage: ./stats input_vcf output_file [-t number_of_threads] [-j]\n"
+    "example: ./stats gatk_hanchild.vcf gatk_hanchild_stats.tsv\n"
+    "example: ./stats gatk_hanchild.vcf.gz gatk_hanchild_stats.json -t 8 -j\n"
+    "\n"
+    "contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
+    return -1;
+  }
+  std::string nameOfInputFile = argv[1];
+  std::string nameOfOutputFile = argv[2];
+  int numberOfThreads = 1;
+  bool asJson = false;
+  for (int argumentIndex = 3; argumentIndex < argc; ++argumentIndex) {
+    std::string option = argv[argumentIndex];
+    if (option == "-t" && argumentIndex + 1 < argc) {
+      numberOfThreads = atoi(argv[++argumentIndex]);
+      if (numberOfThreads < 1) {
+        std::cout << "stats error: the number of threads should be at least 1." << std::endl;
+        return -1;
+      }
+    } else if (option == "-j") {
+      asJson = true;
+    } else {
+      std::cout << "stats error: unknown or incomplete option " << option << std::endl;
+      return -1;
+    }
+  }
+  computeStatistics(nameOfInputFile, nameOfOutputFile, numberOfThreads, asJson);
+  return 0;
+}
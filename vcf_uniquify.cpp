@@ -6,16 +6,30 @@
   chr1 10 AT T Caller=GATK ...chr1 17 G GCC Caller=GATK" 
   becomes "chr1 10 AT T Caller=Pindel ... chr1 17 G GCC Caller=GATK"
 
-  usage: ./uniquify input_vcf output_vcf
+  By default only adjacent duplicates are found, so the input should be sorted. With -g, duplicates
+  are found anywhere in the file (for example in concatenated outputs of several callers), keeping the
+  first occurrence and the order of the file. Events are then remembered by a 64-bit fingerprint of
+  chromosome, position, ref and alt (lines with the same fingerprint are compared exactly); if the
+  fingerprints would take more than the memory budget (-m, in MB, default 1024), the rest of the file is
+  deduplicated through temporary partition files next to the output file.
+
+  usage: ./uniquify input_vcf output_vcf [-g [-m memory_budget_mb]]
   example: ./uniquify pacbio_hanchild.vcf pacbio_hanchild_unique_events.vcf
+  example: ./uniquify all_callers_concatenated.vcf all_callers_unique_events.vcf -g -m 4096
 
   contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
+#include <algorithm> // sort
+#include <cstdio> // remove
+#include <cstdlib> // atof
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 /* Returns whether a string starts with a certain other string, so if
    'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
@@ -89,6 +103,248 @@ void transformFile(const std::string& nameOfInputFile, const std::string& nameOf
 }
 
 
+/** The fields that identify an event: CHROM, POS, REF and ALT **/
+struct EventKey {
+  std::string chrom_;
+  std::string pos_;
+  std::string ref_;
+  std::string alt_;
+};
+
+bool operator==(const EventKey& leftKey, const EventKey& rightKey) {
+  return leftKey.pos_ == rightKey.pos_ && leftKey.chrom_ == rightKey.chrom_ && leftKey.ref_ == rightKey.ref_ &&
+    leftKey.alt_ == rightKey.alt_;
+}
+
+void readEventKey(const std::string& line, EventKey& key) {
+  size_t fieldStarts[6];
+  fieldStarts[0] = 0;
+  for (int fieldIndex = 1; fieldIndex < 6; ++fieldIndex) {
+    size_t tabPosition = line.find('\t', fieldStarts[fieldIndex - 1]);
+    fieldStarts[fieldIndex] = (tabPosition == std::string::npos) ? line.length() + 1 : tabPosition + 1;
+    if (fieldStarts[fieldIndex - 1] > line.length()) {
+      fieldStarts[fieldIndex] = fieldStarts[fieldIndex - 1];
+    }
+  }
+  std::string* fields[4] = { &key.chrom_, &key.pos_, &key.ref_, &key.alt_ };
+  int fieldIndices[4] = { 0, 1, 3, 4 };
+  for (int i = 0; i < 4; ++i) {
+    size_t start = std::min(fieldStarts[fieldIndices[i]], line.length());
+    size_t end = std::min(fieldStarts[fieldIndices[i] + 1] - 1, line.length());
+    fields[i]->assign(line, start, end - start);
+  }
+}
+
+unsigned long long mixBits(unsigned long long value) {
+  // the finalizer of splitmix64
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+/** The 64-bit fingerprint of an event: its chromosome number, position, and a hash (FNV-1a) of REF and ALT **/
+unsigned long long getFingerprint(const EventKey& key, std::map<std::string, int>& contigIds) {
+  std::map<std::string, int>::iterator contigIt = contigIds.find(key.chrom_);
+  if (contigIt == contigIds.end()) {
+    contigIt = contigIds.insert(std::make_pair(key.chrom_, static_cast<int>(contigIds.size()))).first;
+  }
+  unsigned long long alleleHash = 0xcbf29ce484222325ULL;
+  const std::string* alleles[2] = { &key.ref_, &key.alt_ };
+  for (int alleleIndex = 0; alleleIndex < 2; ++alleleIndex) {
+    for (int i = 0; i < alleles[alleleIndex]->length(); ++i) {
+      alleleHash = (alleleHash ^ static_cast<unsigned char>((*alleles[alleleIndex])[i])) * 0x100000001b3ULL;
+    }
+    alleleHash = (alleleHash ^ '\t') * 0x100000001b3ULL;
+  }
+  unsigned long long locus = (static_cast<unsigned long long>(contigIt->second) << 40) ^ atoll(key.pos_.c_str());
+  return mixBits(locus) ^ alleleHash;
+}
+
+/**
+ * Reads the event of the line at 'offset' of the input file, to check whether an event with the same
+ * fingerprint is really the same event.
+ */
+void readEventAt(std::ifstream& inputFile, long long offset, EventKey& key) {
+  inputFile.clear();
+  inputFile.seekg(offset);
+  std::string line;
+  getline(inputFile, line);
+  readEventKey(line, key);
+}
+
+// estimated memory use per remembered event (hash table node plus bucket)
+const int BYTES_PER_FINGERPRINT = 48;
+
+// the number of temporary files over which the events are divided when they exceed the memory budget
+const int NUMBER_OF_PARTITIONS = 64;
+
+/** An event written to a partition file: its fingerprint, its number among the records, and where its line starts **/
+struct SpilledEvent {
+  unsigned long long fingerprint_;
+  long long recordIndex_; // -1 for events that were already written before spilling started
+  long long offset_;
+};
+
+bool operator<(const SpilledEvent& leftEvent, const SpilledEvent& rightEvent) {
+  if (leftEvent.fingerprint_ != rightEvent.fingerprint_) {
+    return leftEvent.fingerprint_ < rightEvent.fingerprint_;
+  }
+  return leftEvent.recordIndex_ < rightEvent.recordIndex_;
+}
+
+std::string getNameOfPartition(const std::string& nameOfOutputFile, int partitionIndex) {
+  std::stringstream ss;
+  ss << nameOfOutputFile << ".partition" << partitionIndex;
+  return ss.str();
+}
+
+/**
+ * Marks the duplicates among the events of one partition file: within each group of events with the
+ * same fingerprint, in the order of the file, an event is a duplicate if an earlier one is the same.
+ */
+void findDuplicatesInPartition(const std::string& nameOfPartition, std::ifstream& lookupFile,
+    long long firstSpilledRecord, std::vector<bool>& isDuplicate) {
+  std::vector<SpilledEvent> events;
+  std::ifstream partitionFile(nameOfPartition.c_str(), std::ios::binary);
+  SpilledEvent event;
+  while (partitionFile.read(reinterpret_cast<char*>(&event), sizeof(event))) {
+    events.push_back(event);
+  }
+  partitionFile.close();
+  std::remove(nameOfPartition.c_str());
+  std::sort(events.begin(), events.end());
+
+  std::vector<EventKey> keptEvents;
+  EventKey key;
+  for (int eventIndex = 0; eventIndex < events.size(); ++eventIndex) {
+    const SpilledEvent& spilledEvent = events[eventIndex];
+    if (eventIndex == 0 || spilledEvent.fingerprint_ != events[eventIndex - 1].fingerprint_) {
+      keptEvents.clear();
+      if (eventIndex + 1 == events.size() || events[eventIndex + 1].fingerprint_ != spilledEvent.fingerprint_) {
+        continue; // a fingerprint that occurs once cannot be a duplicate
+      }
+    }
+    readEventAt(lookupFile, spilledEvent.offset_, key);
+    if (spilledEvent.recordIndex_ >= 0 && std::find(keptEvents.begin(), keptEvents.end(), key) != keptEvents.end()) {
+      isDuplicate[spilledEvent.recordIndex_ - firstSpilledRecord] = true;
+    } else {
+      keptEvents.push_back(key);
+    }
+  }
+}
+
+/**
+ * Global mode: removes duplicates wherever they are in the file, keeping the first occurrence.
+ * The lines are written as they are read while the fingerprints fit in the memory budget; once they
+ * do not, all fingerprints (those seen so far and those of the remaining records) are divided over
+ * partition files, the duplicates of each partition are found, and the remaining records are written
+ * in a second pass over the rest of the file.
+ */
+void transformFileGlobally(const std::string& nameOfInputFile, const std::string& nameOfOutputFile,
+    double memoryBudgetInMb) {
+  std::ifstream inputFile(nameOfInputFile.c_str());
+  std::ifstream lookupFile(nameOfInputFile.c_str());
+  std::ofstream outputFile(nameOfOutputFile.c_str());
+  long long maximumNumberOfFingerprints = memoryBudgetInMb * 1024 * 1024 / BYTES_PER_FINGERPRINT;
+
+  std::map<std::string, int> contigIds;
+  std::unordered_multimap<unsigned long long, long long> fingerprints; // to the offset of the line
+  std::vector<std::ofstream*> partitionFiles;
+  long long firstSpilledRecord = -1;
+  long long offsetOfSpilling = 0;
+  long long recordIndex = 0;
+  long long offset = 0;
+  std::string line;
+  EventKey key;
+  EventKey earlierKey;
+
+  while (getline(inputFile, line)) {
+    long long lineOffset = offset;
+    offset += line.length() + 1;
+    if (line.length() == 0) {
+      break;
+    }
+    if (line[0] == '#') {
+      if (partitionFiles.empty()) {
+        outputFile << line << "\n";
+      }
+      continue;
+    }
+    readEventKey(line, key);
+    unsigned long long fingerprint = getFingerprint(key, contigIds);
+    if (!partitionFiles.empty()) {
+      SpilledEvent spilledEvent = { fingerprint, recordIndex, lineOffset };
+      partitionFiles[fingerprint % NUMBER_OF_PARTITIONS]->write(reinterpret_cast<const char*>(&spilledEvent),
+        sizeof(spilledEvent));
+      ++recordIndex;
+      continue;
+    }
+
+    bool isDuplicate = false;
+    std::pair<std::unordered_multimap<unsigned long long, long long>::iterator,
+      std::unordered_multimap<unsigned long long, long long>::iterator> matches = fingerprints.equal_range(fingerprint);
+    for (std::unordered_multimap<unsigned long long, long long>::iterator it = matches.first;
+        it != matches.second && !isDuplicate; ++it) {
+      readEventAt(lookupFile, it->second, earlierKey);
+      isDuplicate = (earlierKey == key);
+    }
+    if (isDuplicate) {
+      std::cout << key.chrom_ << ":" << key.pos_ << ":" << key.ref_ << ":" << key.alt_ << "\n";
+    } else {
+      outputFile << line << "\n";
+      fingerprints.insert(std::make_pair(fingerprint, lineOffset));
+    }
+    ++recordIndex;
+
+    if (fingerprints.size() > maximumNumberOfFingerprints) {
+      std::cout << "Memory budget reached after " << recordIndex << " records; continuing with "
+        << NUMBER_OF_PARTITIONS << " partition files.\n";
+      firstSpilledRecord = recordIndex;
+      offsetOfSpilling = offset;
+      for (int partitionIndex = 0; partitionIndex < NUMBER_OF_PARTITIONS; ++partitionIndex) {
+        std::string nameOfPartition = getNameOfPartition(nameOfOutputFile, partitionIndex);
+        partitionFiles.push_back(new std::ofstream(nameOfPartition.c_str(), std::ios::binary));
+      }
+      for (std::unordered_multimap<unsigned long long, long long>::iterator it = fingerprints.begin();
+          it != fingerprints.end(); ++it) {
+        SpilledEvent writtenEvent = { it->first, -1, it->second };
+        partitionFiles[it->first % NUMBER_OF_PARTITIONS]->write(reinterpret_cast<const char*>(&writtenEvent),
+          sizeof(writtenEvent));
+      }
+      fingerprints.clear();
+    }
+  }
+
+  if (!partitionFiles.empty()) {
+    std::vector<bool> isDuplicate(recordIndex - firstSpilledRecord, false);
+    for (int partitionIndex = 0; partitionIndex < NUMBER_OF_PARTITIONS; ++partitionIndex) {
+      partitionFiles[partitionIndex]->close();
+      delete partitionFiles[partitionIndex];
+      findDuplicatesInPartition(getNameOfPartition(nameOfOutputFile, partitionIndex), lookupFile,
+        firstSpilledRecord, isDuplicate);
+    }
+    inputFile.clear();
+    inputFile.seekg(offsetOfSpilling);
+    recordIndex = firstSpilledRecord;
+    while (getline(inputFile, line) && line.length() > 0) {
+      if (line[0] == '#') {
+        outputFile << line << "\n";
+      } else if (isDuplicate[recordIndex++ - firstSpilledRecord]) {
+        readEventKey(line, key);
+        std::cout << key.chrom_ << ":" << key.pos_ << ":" << key.ref_ << ":" << key.alt_ << "\n";
+      } else {
+        outputFile << line << "\n";
+      }
+    }
+  }
+  inputFile.close();
+  lookupFile.close();
+  outputFile.close();
+}
+
 int main(int argc, char** argv) {
   
   if (argc < 3) { std::cout <<
@@ -99,15 +355,40 @@ int main(int argc, char** argv) {
     "chr1 10 AT T Caller=GATK ...chr1 17 G GCC Caller=GATK\" " 
     "becomes \"chr1 10 AT T Caller=Pindel ... chr1 17 G GCC Caller=GATK\".\n"
     "\n"
-    "usage: ./uniquify input_vcf output_vcf\n"
+    "By default only adjacent duplicates are found, so the input should be sorted. With -g, duplicates "
+    "are found anywhere in the file (for example in concatenated outputs of several callers), keeping the "
+    "first occurrence and the order of the file. Events are then remembered by a 64-bit fingerprint of "
+    "chromosome, position, ref and alt (lines with the same fingerprint are compared exactly); if the "
+    "fingerprints would take more than the memory budget (-m, in MB, default 1024), the rest of the file is "
+    "deduplicated through temporary partition files next to the output file.\n"
+    "\n"
+    "usage: ./uniquify input_vcf output_vcf [-g [-m memory_budget_mb]]\n"
     "example: ./uniquify pacbio_hanchild.vcf pacbio_hanchild_unique_events.vcf\n"
+    "example: ./uniquify all_callers_concatenated.vcf all_callers_unique_events.vcf -g -m 4096\n"
     "\n"
     "contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
   } else {
     std::cout << "Converting the input VCF to output VCF.\n";
     std::string nameOfInputFile = argv[1];
     std::string nameOfOutputFile = argv[2];
-    transformFile(nameOfInputFile, nameOfOutputFile);  
+    bool isGlobal = false;
+    double memoryBudgetInMb = 1024;
+    for (int argumentIndex = 3; argumentIndex < argc; ++argumentIndex) {
+      std::string option = argv[argumentIndex];
+      if (option == "-g") {
+        isGlobal = true;
+      } else if (option == "-m" && argumentIndex + 1 < argc && atof(argv[argumentIndex + 1]) > 0) {
+        memoryBudgetInMb = atof(argv[++argumentIndex]);
+      } else {
+        std::cout << "uniquify error: unknown or incomplete option " << option << std::endl;
+        return -1;
+      }
+    }
+    if (isGlobal) {
+      transformFileGlobally(nameOfInputFile, nameOfOutputFile, memoryBudgetInMb);
+    } else {
+      transformFile(nameOfInputFile, nameOfOutputFile);
+    }
     std::cout << "Conversion completed.\n";	
   }
   return 0;
@@ -6,17 +6,28 @@
   chr1 10 AT T Caller=GATK ...chr1 17 G GCC Caller=GATK" 
   becomes "chr1 10 AT T Caller=Pindel ... chr1 17 G GCC Caller=GATK"
 
-  usage: ./uniquify_loci input_vcf output_vcf
+  With -p, another event than the first is kept: -p qual keeps the event with the highest QUAL ('.' counts as
+  lowest), -p callers the one supported by most callers (the number of comma-separated names in the INFO field
+  Caller, or another field given with -k; a number, like SUPP=3, is taken as the count), -p longest the one with
+  the longest allele. Of equally good events the first is kept. The input should be sorted, so that events at
+  the same locus are adjacent; only the best event so far at the current locus is kept in memory.
+
+  usage: ./uniquify_loci input_vcf output_vcf [-p first|qual|callers|longest] [-k info_key]
   example: ./uniquify_loci pacbio_hanchild.vcf pacbio_hanchild_unique_loci.vcf
+  example: ./uniquify_loci merged_callers.vcf merged_callers_unique_loci.vcf -p callers -k SUPP
 
   contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com
 **/
 
+#include <algorithm> // max
+#include <cstdlib> // atof
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "symbolic_alleles.h"
+
 /* Returns whether a string starts with a certain other string, so if
    'stringToBeAssessed' is 'albert' and 'putativeStart' is 'al', this function
    returns true. */
@@ -79,6 +90,101 @@ void transformFile(const std::string& nameOfInputFile, const std::string& nameOf
 }
 
 
+enum CollapsePolicy { KEEP_FIRST, HIGHEST_QUAL, MOST_CALLERS, LONGEST_ALLELE };
+
+/** Returns a field of a tab-separated line, or "" if the line has fewer fields **/
+std::string getField(const std::string& line, int fieldIndex) {
+  size_t start = 0;
+  for (int i = 0; i < fieldIndex; ++i) {
+    start = line.find('\t', start);
+    if (start == std::string::npos) {
+      return "";
+    }
+    ++start;
+  }
+  size_t end = line.find('\t', start);
+  return line.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+}
+
+/** How good the event of a line is according to the policy; higher is better **/
+double scoreEvent(const std::string& line, CollapsePolicy policy, const std::string& callerKey) {
+  if (policy == HIGHEST_QUAL) {
+    std::string qual = getField(line, 5);
+    return (qual.empty() || qual == ".") ? -1.0 : atof(qual.c_str());
+  } else if (policy == MOST_CALLERS) {
+    std::string callers;
+    if (!findInfoValue(getField(line, 7), callerKey, callers) || callers.empty()) {
+      return 0;
+    }
+    if (callers.find_first_not_of("0123456789.") == std::string::npos) {
+      return atof(callers.c_str());
+    }
+    int numberOfCallers = 1;
+    for (int i = 0; i < callers.length(); ++i) {
+      numberOfCallers += (callers[i] == ',');
+    }
+    return numberOfCallers;
+  } else if (policy == LONGEST_ALLELE) {
+    std::stringstream alleles(getField(line, 3) + "," + getField(line, 4));
+    std::string allele;
+    int longestLength = 0;
+    while (getline(alleles, allele, ',')) {
+      longestLength = std::max(longestLength, static_cast<int>(allele.length()));
+    }
+    return longestLength;
+  }
+  return 0;
+}
+
+/**
+ * Keeps the best event of each locus according to the policy. Only the best event so far
+ * at the current locus is held; it is written when the next locus starts.
+ */
+void collapseLoci(const std::string& nameOfInputFile, const std::string& nameOfOutputFile, CollapsePolicy policy,
+    const std::string& callerKey) {
+  std::ifstream inputFile(nameOfInputFile.c_str());
+  std::ofstream outputFile(nameOfOutputFile.c_str());
+
+  std::string oldChrom = "";
+  std::string oldPos = "";
+  std::string bestLine = "";
+  double bestScore = 0;
+  std::string line;
+  while (getline(inputFile, line)) {
+    if (line.length() == 0) {
+      break;
+    }
+    if (line[0] == '#') {
+      outputFile << line << "\n";
+      continue;
+    }
+    std::string chrom = getField(line, 0);
+    std::string pos = getField(line, 1);
+    double score = scoreEvent(line, policy, callerKey);
+    if (chrom == oldChrom && pos == oldPos) {
+      std::cout << chrom << ":" << pos << "\n";
+      if (score > bestScore) {
+        bestLine.swap(line);
+        bestScore = score;
+      }
+    } else {
+      if (!bestLine.empty()) {
+        outputFile << bestLine << "\n";
+      }
+      bestLine.swap(line);
+      bestScore = score;
+      oldChrom = chrom;
+      oldPos = pos;
+    }
+  }
+  if (!bestLine.empty()) {
+    outputFile << bestLine << "\n";
+  }
+  inputFile.close();
+  outputFile.close();
+}
+
+
 int main(int argc, char** argv) {
   
   if (argc < 3) { std::cout <<
@@ -89,15 +195,43 @@ int main(int argc, char** argv) {
     "chr1 10 AT T Caller=GATK ...chr1 17 G GCC Caller=GATK\" " 
     "becomes \"chr1 10 AT T Caller=Pindel ... chr1 17 G GCC Caller=GATK\".\n"
     "\n"
-    "usage: ./uniquify_loci input_vcf output_vcf\n"
+    "With -p, another event than the first is kept: -p qual keeps the event with the highest QUAL ('.' counts as "
+    "lowest), -p callers the one supported by most callers (the number of comma-separated names in the INFO field "
+    "Caller, or another field given with -k; a number, like SUPP=3, is taken as the count), -p longest the one with "
+    "the longest allele. Of equally good events the first is kept. The input should be sorted, so that events at "
+    "the same locus are adjacent; only the best event so far at the current locus is kept in memory.\n"
+    "\n"
+    "usage: ./uniquify_loci input_vcf output_vcf [-p first|qual|callers|longest] [-k info_key]\n"
     "example: ./uniquify_loci pacbio_hanchild.vcf pacbio_hanchild_unique_events.vcf\n"
+    "example: ./uniquify_loci merged_callers.vcf merged_callers_unique_loci.vcf -p callers -k SUPP\n"
     "\n"
     "contact data: Eric-Wubbo Lameijer, Xi'an Jiaotong University, eric_wubbo@hotmail.com\n\n";
   } else {
-    std::cout << "Converting the input VCF to output VCF.\n";
     std::string nameOfInputFile = argv[1];
     std::string nameOfOutputFile = argv[2];
-    transformFile(nameOfInputFile, nameOfOutputFile);  
+    CollapsePolicy policy = KEEP_FIRST;
+    std::string callerKey = "Caller";
+    for (int argumentIndex = 3; argumentIndex < argc; ++argumentIndex) {
+      std::string option = argv[argumentIndex];
+      std::string value = (argumentIndex + 1 < argc) ? argv[argumentIndex + 1] : "";
+      if (option == "-p" && (value == "first" || value == "qual" || value == "callers" || value == "longest")) {
+        policy = (value == "qual") ? HIGHEST_QUAL : (value == "callers") ? MOST_CALLERS :
+          (value == "longest") ? LONGEST_ALLELE : KEEP_FIRST;
+        ++argumentIndex;
+      } else if (option == "-k" && !value.empty()) {
+        callerKey = value;
+        ++argumentIndex;
+      } else {
+        std::cout << "uniquify_loci error: unknown or incomplete option " << option << std::endl;
+        return -1;
+      }
+    }
+    std::cout << "Converting the input VCF to output VCF.\n";
+    if (policy == KEEP_FIRST) {
+      transformFile(nameOfInputFile, nameOfOutputFile);
+    } else {
+      collapseLoci(nameOfInputFile, nameOfOutputFile, policy, callerKey);
+    }
     std::cout << "Conversion completed.\n";	
   }
   return 0;